@@ -0,0 +1,226 @@
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+
+#include <benchmark/benchmark.h>
+
+#include "family.h"
+#include "log.h"
+
+// random elements of the finite field
+static std::vector<umod64> random_umod64(unsigned n) {
+  std::mt19937_64 gen(42);
+  std::vector<umod64> nums;
+  for (unsigned i = 0; i < n; ++i)
+    nums.emplace_back(gen() % MOD64.n);
+  return nums;
+}
+
+// random sorted equation with n terms in the columns [0, width)
+static EquationFF random_equation(unsigned n, unsigned width,
+                                  std::mt19937_64 &gen) {
+  std::set<unsigned> cols;
+  while (cols.size() < n)
+    cols.insert(gen() % width);
+  EquationFF equation;
+  for (unsigned col : cols)
+    equation.insert(col, umod64{gen() % (MOD64.n - 1) + 1});
+  equation.sort();
+  return equation;
+}
+
+static void BM_umod64_add(benchmark::State &state) {
+  auto nums = random_umod64(1024);
+  for (auto _ : state) {
+    umod64 acc;
+    for (const auto &num : nums)
+      acc += num;
+    benchmark::DoNotOptimize(acc);
+  }
+  state.SetItemsProcessed(state.iterations() * nums.size());
+}
+BENCHMARK(BM_umod64_add);
+
+static void BM_umod64_mul(benchmark::State &state) {
+  auto nums = random_umod64(1024);
+  for (auto _ : state) {
+    umod64 acc{1};
+    for (const auto &num : nums)
+      acc *= num;
+    benchmark::DoNotOptimize(acc);
+  }
+  state.SetItemsProcessed(state.iterations() * nums.size());
+}
+BENCHMARK(BM_umod64_mul);
+
+static void BM_umod64_div(benchmark::State &state) {
+  auto nums = random_umod64(1024);
+  for (auto &num : nums)
+    if (num == 0)
+      num = umod64{1};
+  for (auto _ : state) {
+    umod64 acc{1};
+    for (const auto &num : nums)
+      acc /= num;
+    benchmark::DoNotOptimize(acc);
+  }
+  state.SetItemsProcessed(state.iterations() * nums.size());
+}
+BENCHMARK(BM_umod64_div);
+
+// y = y + a * x over the field of T, dispatched by vec_isa()
+template <typename T> static void BM_vec_axpy(benchmark::State &state) {
+  std::mt19937_64 gen(42);
+  auto n = (unsigned)state.range(0);
+  std::vector<T> x, y;
+  for (unsigned i = 0; i < n; ++i) {
+    x.emplace_back(gen() % T::modulus());
+    y.emplace_back(gen() % T::modulus());
+  }
+  T a{gen() % T::modulus()};
+  for (auto _ : state) {
+    vec_axpy(y.data(), x.data(), a, n);
+    benchmark::DoNotOptimize(y.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_vec_axpy<umod64>)->Arg(1024);
+BENCHMARK(BM_vec_axpy<umod50>)->Arg(1024);
+BENCHMARK(BM_vec_axpy<umod31>)->Arg(1024);
+
+// one pass reduction of a row by 8 pivot rows of the same length
+// the copy of the row is included
+static void BM_reduce(benchmark::State &state) {
+  std::mt19937_64 gen(42);
+  auto n = (unsigned)state.range(0);
+  const unsigned npivots = 8, width = 4 * n;
+
+  // normalized pivot rows led by the largest columns
+  std::vector<EquationFF> gauss;
+  std::vector<unsigned> lineNumber(width, NO_PIVOT);
+  for (unsigned k = 0; k < npivots; ++k) {
+    EquationFF tail = random_equation(n - 1, width - npivots, gen);
+    EquationFF pivot;
+    pivot.insert(width - 1 - k, umod64{1});
+    for (unsigned i = 0; i < tail.size(); ++i)
+      pivot.insert(tail[i], tail.coeff(i));
+    lineNumber[width - 1 - k] = gauss.size();
+    gauss.push_back(std::move(pivot));
+  }
+
+  // the row contains the leading integrals of all the pivots
+  EquationFF row = random_equation(n, width - npivots, gen);
+  for (unsigned k = 0; k < npivots; ++k)
+    row.insert(width - 1 - k, umod64{gen() % (MOD64.n - 1) + 1});
+  row.sort();
+
+  SparseAccumulator<umod64> spa(width);
+  for (auto _ : state) {
+    EquationFF equation = row;
+    equation.reduce(lineNumber, gauss, spa);
+    benchmark::DoNotOptimize(equation);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_reduce)->RangeMultiplier(4)->Range(16, 8192);
+
+static void BM_integral_hash(benchmark::State &state) {
+  std::mt19937_64 gen(42);
+  auto nprops = (unsigned)state.range(0);
+  std::vector<RawIntegral> integrals;
+  for (unsigned i = 0; i < 1024; ++i) {
+    RawIntegral integral(nprops);
+    for (unsigned j = 0; j < nprops; ++j)
+      integral[j] = (int)(gen() % 7) - 3;
+    integrals.push_back(std::move(integral));
+  }
+
+  std::hash<RawIntegral> hash;
+  for (auto _ : state) {
+    std::size_t acc = 0;
+    for (const auto &integral : integrals)
+      acc ^= hash(integral);
+    benchmark::DoNotOptimize(acc);
+  }
+  state.SetItemsProcessed(state.iterations() * integrals.size());
+}
+BENCHMARK(BM_integral_hash)->Arg(4)->Arg(9)->Arg(12)->Arg(14)->Arg(15);
+
+// an initialized example family
+struct Example {
+  explicit Example(const YAML::Node &config) : family(config) {
+    family.init();
+    family.init_reduce(config, reduce);
+  }
+
+  Family family;
+  Reduce reduce;
+};
+
+// load an example once
+static Example &load_example(const std::string &name) {
+  static std::map<std::string, std::unique_ptr<Example>> examples;
+  if (!examples.contains(name)) {
+    YAML::Node config =
+        YAML::LoadFile(std::string(INIBP_EXAMPLE_DIR) + "/" + name + ".yaml");
+    // symbols of different families share names
+    Family::symtab.clear();
+    // the reduction tables are not written, no file io is timed
+    config["tables"] = "";
+    examples[name] = std::make_unique<Example>(config);
+  }
+  return *examples[name];
+}
+
+// generate the seeds of the top sector
+static void BM_generate_seeds(benchmark::State &state,
+                              const std::string &name) {
+  const Sector &top = load_example(name).reduce.sectors().front();
+  for (auto _ : state) {
+    Sector sector = top;
+    sector.prepare_targets({});
+    benchmark::DoNotOptimize(sector);
+  }
+}
+
+// reduce the top sector
+static void BM_sector_reduction(benchmark::State &state,
+                                const std::string &name) {
+  Example &example = load_example(name);
+  const Sector &top = example.reduce.sectors().front();
+  for (auto _ : state) {
+    Sector sector = top;
+    benchmark::DoNotOptimize(sector.run_reduce(example.family.ibp_ff()));
+  }
+}
+
+int main(int argc, char **argv) {
+  // the solver output goes through the log thread, only errors are kept
+  Log::set_level(LogLevel::Error);
+
+  for (const std::string name : {"box", "sunrise", "dbox"}) {
+    benchmark::RegisterBenchmark(("BM_generate_seeds/" + name).c_str(),
+                                 BM_generate_seeds, name);
+    benchmark::RegisterBenchmark(("BM_sector_reduction/" + name).c_str(),
+                                 BM_sector_reduction, name)
+        ->Unit(benchmark::kMillisecond);
+  }
+
+  // write JSON results for regression tracking unless an output is given
+  std::vector<char *> args(argv, argv + argc);
+  std::string out = "--benchmark_out=inibp_bench.json";
+  std::string format = "--benchmark_out_format=json";
+  if (std::none_of(args.begin(), args.end(), [](const char *arg) {
+        return std::string(arg).starts_with("--benchmark_out=");
+      })) {
+    args.push_back(out.data());
+    args.push_back(format.data());
+  }
+
+  int nargs = (int)args.size();
+  benchmark::Initialize(&nargs, args.data());
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
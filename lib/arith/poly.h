@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// sparse multivariate polynomial over T (umod64 or Rational)
+// terms are stored as exponent vectors and coefficients
+//  exponents of term i: _exps[i * _nvars, (i + 1) * _nvars)
+//  coefficient of term i: _coeffs[i]
+// a canonical polynomial has no zero coefficients and its terms are sorted
+// in descending lexicographic order of exponents
+template <typename T> class SparsePoly {
+public:
+  SparsePoly() = default;
+
+  explicit SparsePoly(unsigned nvars) : _nvars(nvars) {}
+
+  // the constant polynomial
+  static SparsePoly constant(unsigned nvars, const T &coeff) {
+    SparsePoly poly(nvars);
+    if (coeff != T())
+      poly._push(std::vector<unsigned>(nvars, 0).data(), coeff);
+    return poly;
+  }
+
+  // the polynomial x_i
+  static SparsePoly variable(unsigned nvars, unsigned i) {
+    SparsePoly poly(nvars);
+    std::vector<unsigned> exps(nvars, 0);
+    exps[i] = 1;
+    poly._push(exps.data(), T(1));
+    return poly;
+  }
+
+  // number of variables
+  [[nodiscard]] unsigned nvars() const { return _nvars; }
+
+  // number of terms
+  [[nodiscard]] unsigned size() const { return _coeffs.size(); }
+
+  [[nodiscard]] bool is_zero() const { return _coeffs.empty(); }
+
+  // exponents of the i-th term
+  [[nodiscard]] const unsigned *exponents(unsigned i) const {
+    return _exps.data() + (size_t)i * _nvars;
+  }
+
+  // coefficient of the i-th term
+  [[nodiscard]] const T &coeff(unsigned i) const { return _coeffs[i]; }
+
+  // degree in the variable var
+  [[nodiscard]] unsigned degree(unsigned var) const {
+    unsigned deg = 0;
+    for (unsigned i = 0; i < size(); ++i)
+      deg = std::max(deg, exponents(i)[var]);
+    return deg;
+  }
+
+  // total degree
+  [[nodiscard]] unsigned degree() const {
+    unsigned deg = 0;
+    for (unsigned i = 0; i < size(); ++i)
+      deg = std::max(deg, std::accumulate(exponents(i), exponents(i) + _nvars,
+                                          0u));
+    return deg;
+  }
+
+  // append a term, call canonicalize() after the last one
+  void push_term(const unsigned *exps, const T &coeff) { _push(exps, coeff); }
+
+  // sort the terms, merge equal monomials and remove zeros
+  void canonicalize() {
+    std::vector<unsigned> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](unsigned i, unsigned j) {
+      return _compare(exponents(i), exponents(j)) > 0;
+    });
+
+    SparsePoly poly(_nvars);
+    for (unsigned i : order) {
+      if (!poly.is_zero() &&
+          _compare(poly.exponents(poly.size() - 1), exponents(i)) == 0)
+        poly._coeffs.back() += _coeffs[i];
+      else {
+        if (!poly.is_zero() && poly._coeffs.back() == T())
+          poly._pop();
+        poly._push(exponents(i), _coeffs[i]);
+      }
+    }
+    if (!poly.is_zero() && poly._coeffs.back() == T())
+      poly._pop();
+    std::swap(*this, poly);
+  }
+
+  // operators
+
+  SparsePoly operator+(const SparsePoly &other) const {
+    return _merge(other, false);
+  }
+
+  SparsePoly operator-(const SparsePoly &other) const {
+    return _merge(other, true);
+  }
+
+  SparsePoly operator*(const SparsePoly &other) const {
+    SparsePoly poly(_nvars);
+    std::vector<unsigned> exps(_nvars);
+    for (unsigned i = 0; i < size(); ++i)
+      for (unsigned j = 0; j < other.size(); ++j) {
+        for (unsigned v = 0; v < _nvars; ++v)
+          exps[v] = exponents(i)[v] + other.exponents(j)[v];
+        poly._push(exps.data(), _coeffs[i] * other._coeffs[j]);
+      }
+    poly.canonicalize();
+    return poly;
+  }
+
+  SparsePoly operator*(const T &scale) const {
+    if (scale == T())
+      return SparsePoly(_nvars);
+    SparsePoly poly(*this);
+    for (auto &coeff : poly._coeffs)
+      coeff *= scale;
+    return poly;
+  }
+
+  SparsePoly &operator+=(const SparsePoly &other) {
+    return *this = *this + other;
+  }
+
+  SparsePoly &operator-=(const SparsePoly &other) {
+    return *this = *this - other;
+  }
+
+  SparsePoly &operator*=(const SparsePoly &other) {
+    return *this = *this * other;
+  }
+
+  friend SparsePoly operator-(const SparsePoly &poly) {
+    SparsePoly res(poly);
+    for (auto &coeff : res._coeffs)
+      coeff = -coeff;
+    return res;
+  }
+
+  bool operator==(const SparsePoly &other) const {
+    return _nvars == other._nvars && _exps == other._exps &&
+           _coeffs == other._coeffs;
+  }
+
+  // value at the point, point.size() == nvars()
+  [[nodiscard]] T evaluate(const std::vector<T> &point) const {
+    T res;
+    for (unsigned i = 0; i < size(); ++i) {
+      T term = _coeffs[i];
+      const unsigned *exps = exponents(i);
+      for (unsigned v = 0; v < _nvars; ++v) {
+        if (exps[v] == 1)
+          term *= point[v];
+        else if (exps[v] > 1)
+          term *= point[v] ^ exps[v];
+      }
+      res += term;
+    }
+    return res;
+  }
+
+  // substitute the variables [first, nvars) by values
+  // the result is a polynomial in the first variables
+  [[nodiscard]] SparsePoly evaluate_from(unsigned first,
+                                         const std::vector<T> &values) const {
+    SparsePoly poly(first);
+    for (unsigned i = 0; i < size(); ++i) {
+      T term = _coeffs[i];
+      const unsigned *exps = exponents(i);
+      for (unsigned v = first; v < _nvars; ++v) {
+        if (exps[v] == 1)
+          term *= values[v - first];
+        else if (exps[v] > 1)
+          term *= values[v - first] ^ exps[v];
+      }
+      poly._push(exps, term);
+    }
+    poly.canonicalize();
+    return poly;
+  }
+
+  // coefficients of a linear polynomial
+  // [c_1, ..., c_n, c_0] for c_1*x_1 + ... + c_n*x_n + c_0
+  [[nodiscard]] std::vector<T> linear_coeffs() const {
+    std::vector<T> coeffs(_nvars + 1);
+    for (unsigned i = 0; i < size(); ++i) {
+      const unsigned *exps = exponents(i);
+      unsigned deg = std::accumulate(exps, exps + _nvars, 0u);
+      if (deg == 0)
+        coeffs[_nvars] += _coeffs[i];
+      else if (deg == 1)
+        coeffs[std::find(exps, exps + _nvars, 1u) - exps] += _coeffs[i];
+      else
+        throw std::runtime_error("polynomial is not linear");
+    }
+    return coeffs;
+  }
+
+  // coefficients of a polynomial linear in the first variables
+  // [c_1, ..., c_n, c_0] for c_1*x_1 + ... + c_n*x_n + c_0, n = first
+  // c_i are polynomials in the variables [first, nvars)
+  [[nodiscard]] std::vector<SparsePoly>
+  linear_coeffs_in(unsigned first) const {
+    std::vector<SparsePoly> coeffs(first + 1, SparsePoly(_nvars - first));
+    for (unsigned i = 0; i < size(); ++i) {
+      const unsigned *exps = exponents(i);
+      unsigned deg = std::accumulate(exps, exps + first, 0u);
+      if (deg == 0)
+        coeffs[first]._push(exps + first, _coeffs[i]);
+      else if (deg == 1)
+        coeffs[std::find(exps, exps + first, 1u) - exps]._push(exps + first,
+                                                                _coeffs[i]);
+      else
+        throw std::runtime_error("polynomial is not linear");
+    }
+    for (auto &coeff : coeffs)
+      coeff.canonicalize();
+    return coeffs;
+  }
+
+  // map the coefficients to another ring
+  template <typename U, typename F>
+  [[nodiscard]] SparsePoly<U> transform(F f) const {
+    SparsePoly<U> poly(_nvars);
+    for (unsigned i = 0; i < size(); ++i)
+      poly.push_term(exponents(i), f(_coeffs[i]));
+    poly.canonicalize();
+    return poly;
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const SparsePoly &poly) {
+    if (poly.is_zero())
+      return out << "0";
+    for (unsigned i = 0; i < poly.size(); ++i) {
+      if (i != 0)
+        out << " + ";
+      out << "(" << poly._coeffs[i] << ")";
+      for (unsigned v = 0; v < poly._nvars; ++v)
+        if (poly.exponents(i)[v] != 0)
+          out << "*x" << v + 1 << "^" << poly.exponents(i)[v];
+    }
+    return out;
+  }
+
+private:
+  void _push(const unsigned *exps, const T &coeff) {
+    _exps.insert(_exps.end(), exps, exps + _nvars);
+    _coeffs.push_back(coeff);
+  }
+
+  void _pop() {
+    _exps.resize(_exps.size() - _nvars);
+    _coeffs.pop_back();
+  }
+
+  // lexicographic comparison of two exponent vectors
+  int _compare(const unsigned *lhs, const unsigned *rhs) const {
+    for (unsigned v = 0; v < _nvars; ++v)
+      if (lhs[v] != rhs[v])
+        return lhs[v] < rhs[v] ? -1 : 1;
+    return 0;
+  }
+
+  // merge two canonical polynomials
+  SparsePoly _merge(const SparsePoly &other, bool negate) const {
+    SparsePoly poly(_nvars);
+    unsigned i = 0, j = 0;
+    while (i < size() && j < other.size()) {
+      int cmp = _compare(exponents(i), other.exponents(j));
+      if (cmp > 0) {
+        poly._push(exponents(i), _coeffs[i]);
+        ++i;
+      } else if (cmp < 0) {
+        poly._push(other.exponents(j),
+                   negate ? -other._coeffs[j] : other._coeffs[j]);
+        ++j;
+      } else {
+        T coeff = negate ? _coeffs[i] - other._coeffs[j]
+                         : _coeffs[i] + other._coeffs[j];
+        if (coeff != T())
+          poly._push(exponents(i), coeff);
+        ++i;
+        ++j;
+      }
+    }
+    for (; i < size(); ++i)
+      poly._push(exponents(i), _coeffs[i]);
+    for (; j < other.size(); ++j)
+      poly._push(other.exponents(j),
+                 negate ? -other._coeffs[j] : other._coeffs[j]);
+    return poly;
+  }
+
+private:
+  unsigned _nvars = 0;
+  std::vector<unsigned> _exps;
+  std::vector<T> _coeffs;
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "flint/fmpz_mpoly.h"
+#include "flint/fmpz_mpoly_q.h"
+
+#include "poly.h"
+#include "rational.h"
+
+// variables of rational functions, a thin wrapper of flint fmpz_mpoly_ctx
+// it must outlive the rational functions created in it
+class RatFunContext {
+public:
+  explicit RatFunContext(std::vector<std::string> names)
+      : _names(std::move(names)) {
+    fmpz_mpoly_ctx_init(_ctx, (slong)_names.size(), ORD_LEX);
+    for (const auto &name : _names)
+      _cnames.push_back(name.c_str());
+  }
+
+  RatFunContext(const RatFunContext &) = delete;
+
+  RatFunContext &operator=(const RatFunContext &) = delete;
+
+  ~RatFunContext() { fmpz_mpoly_ctx_clear(_ctx); }
+
+  // number of variables
+  [[nodiscard]] unsigned nvars() const { return _names.size(); }
+
+  // names of the variables for printing
+  [[nodiscard]] const char **names() const {
+    return const_cast<const char **>(_cnames.data());
+  }
+
+  const fmpz_mpoly_ctx_struct *get() const { return _ctx; }
+
+private:
+  std::vector<std::string> _names;
+  std::vector<const char *> _cnames;
+  fmpz_mpoly_ctx_t _ctx;
+};
+
+// multivariate rational function over Q, a thin wrapper of flint fmpz_mpoly_q
+// it is always canonical: numerator and denominator are coprime and the
+// denominator has a positive leading coefficient, so zero tests and
+// comparisons are cheap
+class RationalFunction {
+public:
+  // zero
+  explicit RationalFunction(const RatFunContext &ctx) : _ctx(&ctx) {
+    fmpz_mpoly_q_init(_num, _ctx->get());
+  }
+
+  RationalFunction(const RatFunContext &ctx, const Rational &num)
+      : RationalFunction(ctx) {
+    fmpz_mpoly_q_set_fmpq(_num, num.get(), _ctx->get());
+  }
+
+  // the i-th variable
+  static RationalFunction variable(const RatFunContext &ctx, unsigned i) {
+    RationalFunction res(ctx);
+    fmpz_mpoly_q_gen(res._num, i, ctx.get());
+    return res;
+  }
+
+  // the polynomial in the variables of ctx, poly.nvars() == ctx.nvars()
+  static RationalFunction from_poly(const RatFunContext &ctx,
+                                    const SparsePoly<Rational> &poly) {
+    RationalFunction res(ctx);
+    // numerator: the terms times the lcm of their denominators
+    fmpz_t lcm, coeff;
+    fmpz_init(lcm);
+    fmpz_init(coeff);
+    fmpz_one(lcm);
+    for (unsigned i = 0; i < poly.size(); ++i)
+      fmpz_lcm(lcm, lcm, fmpq_denref(poly.coeff(i).get()));
+    std::vector<ulong> exps(poly.nvars());
+    for (unsigned i = 0; i < poly.size(); ++i) {
+      const fmpq *num = poly.coeff(i).get();
+      fmpz_divexact(coeff, lcm, fmpq_denref(num));
+      fmpz_mul(coeff, coeff, fmpq_numref(num));
+      std::copy(poly.exponents(i), poly.exponents(i) + poly.nvars(),
+                exps.begin());
+      fmpz_mpoly_push_term_fmpz_ui(fmpz_mpoly_q_numref(res._num), coeff,
+                                   exps.data(), ctx.get());
+    }
+    fmpz_mpoly_sort_terms(fmpz_mpoly_q_numref(res._num), ctx.get());
+    fmpz_mpoly_combine_like_terms(fmpz_mpoly_q_numref(res._num), ctx.get());
+    fmpz_mpoly_set_fmpz(fmpz_mpoly_q_denref(res._num), lcm, ctx.get());
+    fmpz_mpoly_q_canonicalise(res._num, ctx.get());
+    fmpz_clear(lcm);
+    fmpz_clear(coeff);
+    return res;
+  }
+
+  RationalFunction(const RationalFunction &other) : RationalFunction(*other._ctx) {
+    fmpz_mpoly_q_set(_num, other._num, _ctx->get());
+  }
+
+  RationalFunction(RationalFunction &&other) noexcept
+      : RationalFunction(*other._ctx) {
+    fmpz_mpoly_q_swap(_num, other._num, _ctx->get());
+  }
+
+  ~RationalFunction() { fmpz_mpoly_q_clear(_num, _ctx->get()); }
+
+  RationalFunction &operator=(const RationalFunction &other) {
+    if (this != &other)
+      fmpz_mpoly_q_set(_num, other._num, _ctx->get());
+    return *this;
+  }
+
+  RationalFunction &operator=(RationalFunction &&other) noexcept {
+    fmpz_mpoly_q_swap(_num, other._num, _ctx->get());
+    return *this;
+  }
+
+  // operators
+
+  RationalFunction operator+(const RationalFunction &other) const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_add(res._num, _num, other._num, _ctx->get());
+    return res;
+  }
+
+  RationalFunction operator-(const RationalFunction &other) const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_sub(res._num, _num, other._num, _ctx->get());
+    return res;
+  }
+
+  RationalFunction operator*(const RationalFunction &other) const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_mul(res._num, _num, other._num, _ctx->get());
+    return res;
+  }
+
+  RationalFunction operator/(const RationalFunction &other) const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_div(res._num, _num, other._num, _ctx->get());
+    return res;
+  }
+
+  RationalFunction operator*(slong scale) const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_mul_si(res._num, _num, scale, _ctx->get());
+    return res;
+  }
+
+  RationalFunction &operator+=(const RationalFunction &other) {
+    fmpz_mpoly_q_add(_num, _num, other._num, _ctx->get());
+    return *this;
+  }
+
+  RationalFunction &operator-=(const RationalFunction &other) {
+    fmpz_mpoly_q_sub(_num, _num, other._num, _ctx->get());
+    return *this;
+  }
+
+  RationalFunction &operator*=(const RationalFunction &other) {
+    fmpz_mpoly_q_mul(_num, _num, other._num, _ctx->get());
+    return *this;
+  }
+
+  RationalFunction &operator/=(const RationalFunction &other) {
+    fmpz_mpoly_q_div(_num, _num, other._num, _ctx->get());
+    return *this;
+  }
+
+  bool operator==(const RationalFunction &other) const {
+    return fmpz_mpoly_q_equal(_num, other._num, _ctx->get());
+  }
+
+  bool operator!=(const RationalFunction &other) const {
+    return !fmpz_mpoly_q_equal(_num, other._num, _ctx->get());
+  }
+
+  friend RationalFunction operator-(const RationalFunction &num) {
+    RationalFunction res(*num._ctx);
+    fmpz_mpoly_q_neg(res._num, num._num, num._ctx->get());
+    return res;
+  }
+
+  [[nodiscard]] bool is_zero() const {
+    return fmpz_mpoly_q_is_zero(_num, _ctx->get());
+  }
+
+  [[nodiscard]] bool is_one() const {
+    return fmpz_mpoly_q_is_one(_num, _ctx->get());
+  }
+
+  // the inverse, it must not be zero
+  [[nodiscard]] RationalFunction inverse() const {
+    RationalFunction res(*_ctx);
+    fmpz_mpoly_q_inv(res._num, _num, _ctx->get());
+    return res;
+  }
+
+  friend std::ostream &operator<<(std::ostream &out,
+                                  const RationalFunction &num) {
+    char *str = fmpz_mpoly_q_get_str_pretty(num._num, num._ctx->names(),
+                                            num._ctx->get());
+    out << str;
+    flint_free(str);
+    return out;
+  }
+
+private:
+  const RatFunContext *_ctx;
+  fmpz_mpoly_q_t _num;
+};
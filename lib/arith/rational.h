@@ -0,0 +1,149 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "flint/fmpz.h"
+#include "flint/fmpq.h"
+
+#include "umod.h"
+
+// arbitrary precision rational number, a thin wrapper of flint fmpq
+class Rational {
+public:
+  Rational() { fmpq_init(_num); }
+
+  Rational(sint64 num) {
+    fmpq_init(_num);
+    fmpq_set_si(_num, num, 1);
+  }
+
+  Rational(sint64 numer, uint64 denom) {
+    fmpq_init(_num);
+    fmpq_set_si(_num, numer, denom);
+  }
+
+  // the fraction numer/denom, it is canonicalised
+  Rational(const fmpz_t numer, const fmpz_t denom) {
+    fmpq_init(_num);
+    fmpq_set_fmpz_frac(_num, numer, denom);
+  }
+
+  // parse a string like "-3/4"
+  explicit Rational(const std::string &s) {
+    fmpq_init(_num);
+    fmpq_set_str(_num, s.c_str(), 10);
+  }
+
+  Rational(const Rational &other) {
+    fmpq_init(_num);
+    fmpq_set(_num, other._num);
+  }
+
+  Rational(Rational &&other) noexcept {
+    fmpq_init(_num);
+    fmpq_swap(_num, other._num);
+  }
+
+  ~Rational() { fmpq_clear(_num); }
+
+  Rational &operator=(const Rational &other) {
+    if (this != &other)
+      fmpq_set(_num, other._num);
+    return *this;
+  }
+
+  Rational &operator=(Rational &&other) noexcept {
+    fmpq_swap(_num, other._num);
+    return *this;
+  }
+
+  // operators
+
+  Rational operator+(const Rational &other) const {
+    Rational res;
+    fmpq_add(res._num, _num, other._num);
+    return res;
+  }
+
+  Rational operator-(const Rational &other) const {
+    Rational res;
+    fmpq_sub(res._num, _num, other._num);
+    return res;
+  }
+
+  Rational operator*(const Rational &other) const {
+    Rational res;
+    fmpq_mul(res._num, _num, other._num);
+    return res;
+  }
+
+  Rational operator/(const Rational &other) const {
+    Rational res;
+    fmpq_div(res._num, _num, other._num);
+    return res;
+  }
+
+  Rational operator^(uint64 pow) const {
+    Rational res;
+    fmpq_pow_si(res._num, _num, (sint64)pow);
+    return res;
+  }
+
+  Rational &operator+=(const Rational &other) {
+    fmpq_add(_num, _num, other._num);
+    return *this;
+  }
+
+  Rational &operator-=(const Rational &other) {
+    fmpq_sub(_num, _num, other._num);
+    return *this;
+  }
+
+  Rational &operator*=(const Rational &other) {
+    fmpq_mul(_num, _num, other._num);
+    return *this;
+  }
+
+  Rational &operator/=(const Rational &other) {
+    fmpq_div(_num, _num, other._num);
+    return *this;
+  }
+
+  bool operator==(const Rational &other) const {
+    return fmpq_equal(_num, other._num);
+  }
+
+  bool operator!=(const Rational &other) const {
+    return !fmpq_equal(_num, other._num);
+  }
+
+  friend Rational operator-(const Rational &num) {
+    Rational res;
+    fmpq_neg(res._num, num._num);
+    return res;
+  }
+
+  [[nodiscard]] bool is_zero() const { return fmpq_is_zero(_num); }
+
+  // the image in the finite field
+  [[nodiscard]] umod64 to_umod64() const { return umod64::from(_num); }
+
+  // the image in the finite field of T
+  template <typename T> [[nodiscard]] T to_mod() const { return T::from(_num); }
+
+  // the underlying flint number
+  const fmpq *get() const { return _num; }
+
+  fmpq *get() { return _num; }
+
+  friend std::ostream &operator<<(std::ostream &out, const Rational &num) {
+    char *str = fmpq_get_str(nullptr, 10, num._num);
+    out << str;
+    flint_free(str);
+    return out;
+  }
+
+private:
+  fmpq_t _num;
+};
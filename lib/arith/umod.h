@@ -9,6 +9,7 @@
 
 typedef unsigned long uint64;
 typedef signed long sint64;
+typedef unsigned __int128 uint128;
 
 const nmod_t MOD64{9223372036854775783, 50, 1};
 const uint64 PRIMES64[] = {
@@ -30,103 +31,155 @@ const uint64 PRIMES64[] = {
         1277294106943470761
 };
 
-// finite field over 9223372036854775783 (the largest 63 bit prime)
-// use umod64::from() to convert a signed integer to umod64
-class umod64 {
+// prime fields of umod, n: the prime, ninv and norm: as in flint nmod_init
+// the largest 63 bit prime
+struct Prime63 {
+  static constexpr nmod_t mod{9223372036854775783, 50, 1};
+};
+// the largest 50 bit prime
+struct Prime50 {
+  static constexpr nmod_t mod{1125899906842597, 442368, 14};
+};
+// the largest 31 bit prime, 2^31 - 1
+struct Prime31 {
+  static constexpr nmod_t mod{2147483647, 8589934596, 33};
+};
+
+// finite field over the prime of Field
+// use umod::from() to convert a signed integer to umod
+template <typename Field> class umod {
 public:
-  umod64() = default;
+  // products of two residues that can be added to a residue in 128 bits
+  // before it has to be reduced, capped at 255
+  static constexpr unsigned DELAYED_PRODUCTS = [] {
+    uint128 square = (uint128)(Field::mod.n - 1) * (Field::mod.n - 1);
+    uint128 products = (~(uint128)0 - Field::mod.n) / square;
+    return products > 255 ? 255u : (unsigned)products;
+  }();
 
-  // it is assumed that num is in the range [0, MOD64)
-  explicit umod64(uint64 num) : _num(num) {}
+  umod() = default;
 
-  // convert a signed integer to a umod64
-  static umod64 from(sint64 num) {
-    umod64 res;
+  // it is assumed that num is in the range [0, modulus())
+  explicit umod(uint64 num) : _num(num) {}
+
+  // the prime
+  static constexpr uint64 modulus() { return Field::mod.n; }
+
+  // convert a signed integer to a umod
+  static umod from(sint64 num) {
+    umod res;
     if (num > 0) {
-      NMOD_RED(res._num, num, MOD64);
+      NMOD_RED(res._num, num, Field::mod);
     }
     else if (num < 0) {
-      NMOD_RED(res._num, -num, MOD64);
+      NMOD_RED(res._num, -num, Field::mod);
       return -res;
     }
     return res;
   }
 
-  // convert a string to a umod64
-  static umod64 from(const std::string &s) {
+  // reduce a 128 bit integer
+  static umod reduce(uint128 num) {
+    umod res;
+    NMOD2_RED2(res._num, (uint64)(num >> 64), (uint64)num, Field::mod);
+    return res;
+  }
+
+  // convert a rational number to a umod
+  static umod from(const fmpq_t num) {
+    umod numer, denom;
+    numer._num = fmpz_get_nmod(fmpq_numref(num), Field::mod);
+    denom._num = fmpz_get_nmod(fmpq_denref(num), Field::mod);
+    return numer / denom;
+  }
+
+  // convert a string to a umod
+  static umod from(const std::string &s) {
     // the string may be a rational number
     fmpq_t num;
     fmpq_init(num);
     fmpq_set_str(num, s.c_str(), 10);
 
-    umod64 numer, denom;
-    numer._num = fmpz_get_nmod(fmpq_numref(num), MOD64);
-    denom._num = fmpz_get_nmod(fmpq_denref(num), MOD64);
-    numer /= denom;
+    umod res = from(num);
 
     fmpq_clear(num);
-    return numer;
+    return res;
   }
 
   // operators
 
-  umod64 operator+(const umod64 &other) const {
-    return umod64{_nmod_add(_num, other._num, MOD64)};
+  umod operator+(const umod &other) const {
+    return umod{_nmod_add(_num, other._num, Field::mod)};
   }
 
-  umod64 operator-(const umod64 &other) const {
-    return umod64{_nmod_sub(_num, other._num, MOD64)};
+  umod operator-(const umod &other) const {
+    return umod{_nmod_sub(_num, other._num, Field::mod)};
   }
 
-  umod64 operator*(const umod64 &other) const {
-    return umod64{nmod_mul(_num, other._num, MOD64)};
+  umod operator*(const umod &other) const {
+    return umod{nmod_mul(_num, other._num, Field::mod)};
   }
 
-  umod64 operator/(const umod64 &other) const {
-    return umod64{nmod_div(_num, other._num, MOD64)};
+  umod operator/(const umod &other) const {
+    return umod{nmod_div(_num, other._num, Field::mod)};
   }
 
-  umod64 operator^(uint64 pow) const {
-    return umod64{nmod_pow_ui(_num, pow, MOD64)};
+  umod operator^(uint64 pow) const {
+    return umod{nmod_pow_ui(_num, pow, Field::mod)};
   }
 
-  umod64 &operator+=(const umod64 &other) {
-    _num = _nmod_add(_num, other._num, MOD64);
+  umod &operator+=(const umod &other) {
+    _num = _nmod_add(_num, other._num, Field::mod);
     return *this;
   }
 
-  umod64 &operator-=(const umod64 &other) {
-    _num = _nmod_sub(_num, other._num, MOD64);
+  umod &operator-=(const umod &other) {
+    _num = _nmod_sub(_num, other._num, Field::mod);
     return *this;
   }
 
-  umod64 &operator*=(const umod64 &other) {
-    _num = nmod_mul(_num, other._num, MOD64);
+  umod &operator*=(const umod &other) {
+    _num = nmod_mul(_num, other._num, Field::mod);
     return *this;
   }
 
-  umod64 &operator/=(const umod64 &other) {
-    _num = nmod_div(_num, other._num, MOD64);
+  umod &operator/=(const umod &other) {
+    _num = nmod_div(_num, other._num, Field::mod);
     return *this;
   }
 
-  bool operator==(const umod64 &other) const { return _num == other._num; }
+  // the residue in [0, modulus())
+  [[nodiscard]] uint64 value() const { return _num; }
+
+  // the product without reduction, use reduce() to get the residue
+  [[nodiscard]] uint128 mul_wide(const umod &other) const {
+    return (uint128)_num * other._num;
+  }
 
-  bool operator!=(const umod64 &other) const { return _num != other._num; }
+  bool operator==(const umod &other) const { return _num == other._num; }
+
+  bool operator!=(const umod &other) const { return _num != other._num; }
 
   bool operator==(uint64 other) const { return _num == other; }
 
   bool operator!=(uint64 other) const { return _num != other; }
 
-  friend umod64 operator-(const umod64 &num) {
-    return umod64{nmod_neg(num._num, MOD64)};
+  friend umod operator-(const umod &num) {
+    return umod{nmod_neg(num._num, Field::mod)};
   }
 
-  friend std::ostream &operator<<(std::ostream &out, const umod64 &num) {
+  friend std::ostream &operator<<(std::ostream &out, const umod &num) {
     out << num._num;
     return out;
   }
 
 private:
   uint64 _num = 0;
-};
\ No newline at end of file
+};
+
+// finite field over 9223372036854775783 (the largest 63 bit prime)
+typedef umod<Prime63> umod64;
+// finite field over 1125899906842597 (the largest 50 bit prime)
+typedef umod<Prime50> umod50;
+// finite field over 2147483647 (the largest 31 bit prime)
+typedef umod<Prime31> umod31;
@@ -0,0 +1,258 @@
+#include "umodvec.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// scalar kernels
+
+static void axpy_scalar(uint64 *y, const uint64 *x, uint64 a, size_t n,
+                        nmod_t mod) {
+  for (size_t i = 0; i < n; ++i)
+    y[i] = _nmod_add(y[i], nmod_mul(a, x[i], mod), mod);
+}
+
+static void scale_scalar(uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  for (size_t i = 0; i < n; ++i)
+    x[i] = nmod_mul(a, x[i], mod);
+}
+
+static uint64 dot_scalar(const uint64 *x, const uint64 *y, size_t n,
+                         nmod_t mod) {
+  uint64 res = 0;
+  for (size_t i = 0; i < n; ++i)
+    res = _nmod_add(res, nmod_mul(x[i], y[i], mod), mod);
+  return res;
+}
+
+#if defined(__x86_64__)
+
+// double precision kernels for primes below 2^50
+// a residue r < 2^52 is converted to a double by setting the bits of 2^52 + r
+// the product a * b is split exactly into h + l with a fma, the quotient
+// floor(h / p) is off by at most one, so r = a * b - q * p lies in [-p, 2p)
+// and is computed exactly
+
+// 2^52 as integer bits and as double
+static const uint64 MAGIC_BITS = 0x4330000000000000;
+static const double MAGIC = 4503599627370496.0;
+
+__attribute__((target("avx2,fma"))) static inline __m256d
+to_pd(__m256i x) {
+  return _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(x, _mm256_set1_epi64x(MAGIC_BITS))),
+      _mm256_set1_pd(MAGIC));
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256i
+from_pd(__m256d x) {
+  return _mm256_xor_si256(_mm256_castpd_si256(_mm256_add_pd(x, _mm256_set1_pd(MAGIC))),
+                          _mm256_set1_epi64x(MAGIC_BITS));
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256d
+mulmod_pd(__m256d a, __m256d b, __m256d p, __m256d pinv) {
+  __m256d h = _mm256_mul_pd(a, b);
+  __m256d l = _mm256_fmsub_pd(a, b, h);
+  __m256d q = _mm256_floor_pd(_mm256_mul_pd(h, pinv));
+  __m256d r = _mm256_add_pd(_mm256_fnmadd_pd(q, p, h), l);
+  r = _mm256_add_pd(
+      r, _mm256_and_pd(_mm256_cmp_pd(r, _mm256_setzero_pd(), _CMP_LT_OQ), p));
+  return _mm256_sub_pd(r, _mm256_and_pd(_mm256_cmp_pd(r, p, _CMP_GE_OQ), p));
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256d
+addmod_pd(__m256d a, __m256d b, __m256d p) {
+  __m256d r = _mm256_add_pd(a, b);
+  return _mm256_sub_pd(r, _mm256_and_pd(_mm256_cmp_pd(r, p, _CMP_GE_OQ), p));
+}
+
+__attribute__((target("avx2,fma"))) static void
+axpy_avx2(uint64 *y, const uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  __m256d p = _mm256_set1_pd((double)mod.n);
+  __m256d pinv = _mm256_set1_pd(1.0 / (double)mod.n);
+  __m256d va = _mm256_set1_pd((double)a);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d vx = to_pd(_mm256_loadu_si256((const __m256i *)(x + i)));
+    __m256d vy = to_pd(_mm256_loadu_si256((const __m256i *)(y + i)));
+    vy = addmod_pd(vy, mulmod_pd(va, vx, p, pinv), p);
+    _mm256_storeu_si256((__m256i *)(y + i), from_pd(vy));
+  }
+  axpy_scalar(y + i, x + i, a, n - i, mod);
+}
+
+__attribute__((target("avx2,fma"))) static void
+scale_avx2(uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  __m256d p = _mm256_set1_pd((double)mod.n);
+  __m256d pinv = _mm256_set1_pd(1.0 / (double)mod.n);
+  __m256d va = _mm256_set1_pd((double)a);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d vx = to_pd(_mm256_loadu_si256((const __m256i *)(x + i)));
+    _mm256_storeu_si256((__m256i *)(x + i),
+                        from_pd(mulmod_pd(va, vx, p, pinv)));
+  }
+  scale_scalar(x + i, a, n - i, mod);
+}
+
+__attribute__((target("avx2,fma"))) static uint64
+dot_avx2(const uint64 *x, const uint64 *y, size_t n, nmod_t mod) {
+  __m256d p = _mm256_set1_pd((double)mod.n);
+  __m256d pinv = _mm256_set1_pd(1.0 / (double)mod.n);
+  __m256d acc = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d vx = to_pd(_mm256_loadu_si256((const __m256i *)(x + i)));
+    __m256d vy = to_pd(_mm256_loadu_si256((const __m256i *)(y + i)));
+    acc = addmod_pd(acc, mulmod_pd(vx, vy, p, pinv), p);
+  }
+  alignas(32) uint64 lanes[4];
+  _mm256_store_si256((__m256i *)lanes, from_pd(acc));
+  uint64 res = dot_scalar(x + i, y + i, n - i, mod);
+  for (uint64 lane : lanes)
+    res = _nmod_add(res, lane, mod);
+  return res;
+}
+
+__attribute__((target("avx512f"))) static inline __m512d
+to_pd(__m512i x) {
+  return _mm512_sub_pd(
+      _mm512_castsi512_pd(_mm512_or_si512(x, _mm512_set1_epi64(MAGIC_BITS))),
+      _mm512_set1_pd(MAGIC));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+from_pd(__m512d x) {
+  return _mm512_xor_si512(_mm512_castpd_si512(_mm512_add_pd(x, _mm512_set1_pd(MAGIC))),
+                          _mm512_set1_epi64(MAGIC_BITS));
+}
+
+__attribute__((target("avx512f"))) static inline __m512d
+mulmod_pd(__m512d a, __m512d b, __m512d p, __m512d pinv) {
+  __m512d h = _mm512_mul_pd(a, b);
+  __m512d l = _mm512_fmsub_pd(a, b, h);
+  __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(h, pinv),
+                                   _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  __m512d r = _mm512_add_pd(_mm512_fnmadd_pd(q, p, h), l);
+  r = _mm512_mask_add_pd(
+      r, _mm512_cmp_pd_mask(r, _mm512_setzero_pd(), _CMP_LT_OQ), r, p);
+  return _mm512_mask_sub_pd(r, _mm512_cmp_pd_mask(r, p, _CMP_GE_OQ), r, p);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d
+addmod_pd(__m512d a, __m512d b, __m512d p) {
+  __m512d r = _mm512_add_pd(a, b);
+  return _mm512_mask_sub_pd(r, _mm512_cmp_pd_mask(r, p, _CMP_GE_OQ), r, p);
+}
+
+__attribute__((target("avx512f"))) static void
+axpy_avx512(uint64 *y, const uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  __m512d p = _mm512_set1_pd((double)mod.n);
+  __m512d pinv = _mm512_set1_pd(1.0 / (double)mod.n);
+  __m512d va = _mm512_set1_pd((double)a);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d vx = to_pd(_mm512_loadu_si512(x + i));
+    __m512d vy = to_pd(_mm512_loadu_si512(y + i));
+    vy = addmod_pd(vy, mulmod_pd(va, vx, p, pinv), p);
+    _mm512_storeu_si512(y + i, from_pd(vy));
+  }
+  axpy_scalar(y + i, x + i, a, n - i, mod);
+}
+
+__attribute__((target("avx512f"))) static void
+scale_avx512(uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  __m512d p = _mm512_set1_pd((double)mod.n);
+  __m512d pinv = _mm512_set1_pd(1.0 / (double)mod.n);
+  __m512d va = _mm512_set1_pd((double)a);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d vx = to_pd(_mm512_loadu_si512(x + i));
+    _mm512_storeu_si512(x + i, from_pd(mulmod_pd(va, vx, p, pinv)));
+  }
+  scale_scalar(x + i, a, n - i, mod);
+}
+
+__attribute__((target("avx512f"))) static uint64
+dot_avx512(const uint64 *x, const uint64 *y, size_t n, nmod_t mod) {
+  __m512d p = _mm512_set1_pd((double)mod.n);
+  __m512d pinv = _mm512_set1_pd(1.0 / (double)mod.n);
+  __m512d acc = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d vx = to_pd(_mm512_loadu_si512(x + i));
+    __m512d vy = to_pd(_mm512_loadu_si512(y + i));
+    acc = addmod_pd(acc, mulmod_pd(vx, vy, p, pinv), p);
+  }
+  alignas(64) uint64 lanes[8];
+  _mm512_store_si512(lanes, from_pd(acc));
+  uint64 res = dot_scalar(x + i, y + i, n - i, mod);
+  for (uint64 lane : lanes)
+    res = _nmod_add(res, lane, mod);
+  return res;
+}
+
+#endif
+
+// dispatch
+
+VecIsa _vec_detect_isa() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return VecIsa::AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return VecIsa::AVX2;
+#endif
+  return VecIsa::Scalar;
+}
+
+// the instruction set for the prime
+static VecIsa isa_for(nmod_t mod) {
+  return mod.n < VEC_PRIME_BOUND ? vec_isa() : VecIsa::Scalar;
+}
+
+void _vec_axpy(uint64 *y, const uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  switch (isa_for(mod)) {
+#if defined(__x86_64__)
+  case VecIsa::AVX512:
+    return axpy_avx512(y, x, a, n, mod);
+  case VecIsa::AVX2:
+    return axpy_avx2(y, x, a, n, mod);
+#endif
+  default:
+    return axpy_scalar(y, x, a, n, mod);
+  }
+}
+
+void _vec_scale(uint64 *x, uint64 a, size_t n, nmod_t mod) {
+  switch (isa_for(mod)) {
+#if defined(__x86_64__)
+  case VecIsa::AVX512:
+    return scale_avx512(x, a, n, mod);
+  case VecIsa::AVX2:
+    return scale_avx2(x, a, n, mod);
+#endif
+  default:
+    return scale_scalar(x, a, n, mod);
+  }
+}
+
+uint64 _vec_dot(const uint64 *x, const uint64 *y, size_t n, nmod_t mod) {
+  switch (isa_for(mod)) {
+#if defined(__x86_64__)
+  case VecIsa::AVX512:
+    return dot_avx512(x, y, n, mod);
+  case VecIsa::AVX2:
+    return dot_avx2(x, y, n, mod);
+#endif
+  default:
+    return dot_scalar(x, y, n, mod);
+  }
+}
+
+void _vec_reduce(uint64 *out, const uint128 *in, size_t n, nmod_t mod) {
+  for (size_t i = 0; i < n; ++i)
+    NMOD2_RED2(out[i], (uint64)(in[i] >> 64), (uint64)in[i], mod);
+}
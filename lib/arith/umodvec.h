@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+
+#include "umod.h"
+
+// vector kernels over arrays of residues
+// the kernels are dispatched at runtime on the cpu and the prime:
+//  primes below 2^50 use double precision fma, 4 lanes with AVX2 and FMA,
+//  8 lanes with AVX-512F
+//  larger primes and other cpus use the scalar flint nmod operations
+enum class VecIsa { Scalar, AVX2, AVX512 };
+
+// primes below the bound have vector kernels
+constexpr uint64 VEC_PRIME_BOUND = 1ul << 50;
+
+// shorter dot products stay inline, the call and the horizontal sum of the
+// vector kernel cost more than the zeros skipped by the loop
+constexpr size_t VEC_DOT_MIN = 32;
+
+// the instruction set of the cpu, detected once
+VecIsa _vec_detect_isa();
+
+// the instruction set used for primes below 2^50
+inline VecIsa vec_isa() {
+  static const VecIsa isa = _vec_detect_isa();
+  return isa;
+}
+
+// raw kernels on residues in [0, mod.n)
+// y = y + a * x
+void _vec_axpy(uint64 *y, const uint64 *x, uint64 a, size_t n, nmod_t mod);
+// x = a * x
+void _vec_scale(uint64 *x, uint64 a, size_t n, nmod_t mod);
+// sum x_i * y_i
+uint64 _vec_dot(const uint64 *x, const uint64 *y, size_t n, nmod_t mod);
+// out_i = in_i mod n
+void _vec_reduce(uint64 *out, const uint128 *in, size_t n, nmod_t mod);
+
+// typed kernels over umod arrays
+static_assert(sizeof(umod64) == sizeof(uint64));
+
+template <typename Field>
+void vec_axpy(umod<Field> *y, const umod<Field> *x, umod<Field> a, size_t n) {
+  _vec_axpy(reinterpret_cast<uint64 *>(y), reinterpret_cast<const uint64 *>(x),
+            a.value(), n, Field::mod);
+}
+
+template <typename Field>
+void vec_scale(umod<Field> *x, umod<Field> a, size_t n) {
+  _vec_scale(reinterpret_cast<uint64 *>(x), a.value(), n, Field::mod);
+}
+
+// short vectors and fields without a vector kernel use an inline loop that
+// skips the zeros of x, the coefficient vectors of the ibp terms are short
+// and mostly zero
+template <typename Field>
+umod<Field> vec_dot(const umod<Field> *x, const umod<Field> *y, size_t n) {
+  if (n < VEC_DOT_MIN || Field::mod.n >= VEC_PRIME_BOUND ||
+      vec_isa() == VecIsa::Scalar) {
+    umod<Field> res;
+    for (size_t i = 0; i < n; ++i)
+      if (x[i] != 0)
+        res += x[i] * y[i];
+    return res;
+  }
+  return umod<Field>{_vec_dot(reinterpret_cast<const uint64 *>(x),
+                              reinterpret_cast<const uint64 *>(y), n,
+                              Field::mod)};
+}
+
+template <typename Field>
+void vec_reduce(umod<Field> *out, const uint128 *in, size_t n) {
+  _vec_reduce(reinterpret_cast<uint64 *>(out), in, n, Field::mod);
+}
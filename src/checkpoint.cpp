@@ -0,0 +1,169 @@
+#include "checkpoint.h"
+
+#include <filesystem>
+#include <fstream>
+
+// magic numbers of the checkpoint files
+static const uint64_t STATE_MAGIC = 0x4554415453504249; // IBPSTATE
+static const uint64_t SNAPSHOT_MAGIC = 0x3250414e53504249; // IBPSNAP2
+
+template <typename F>
+void Checkpoint::_write(const std::string &path, F writer) const {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw std::runtime_error("cannot write checkpoint " + tmp);
+    writer(file);
+    if (!file)
+      throw std::runtime_error("cannot write checkpoint " + tmp);
+  }
+  std::filesystem::rename(tmp, path);
+}
+
+void Checkpoint::reset() const {
+  std::filesystem::create_directories(_path);
+  for (const auto &entry : std::filesystem::directory_iterator(_path)) {
+    std::string name = entry.path().filename().string();
+    if (name.starts_with("sector_") || name.starts_with("snapshot_") ||
+        name.starts_with("state"))
+      std::filesystem::remove(entry.path());
+  }
+}
+
+void Checkpoint::save_state(uint64_t hash, uint64_t modulus,
+                            const std::vector<umod64> &values) {
+  _modulus = modulus;
+  std::filesystem::create_directories(_path);
+  _write(_path + "/state.bin", [&](std::ofstream &file) {
+    write_binary(file, STATE_MAGIC);
+    write_binary(file, hash);
+    write_binary(file, modulus);
+    write_binary<uint32_t>(file, values.size());
+    for (const auto &value : values)
+      write_binary(file, value.value());
+  });
+}
+
+bool Checkpoint::load_state(uint64_t hash, uint64_t modulus,
+                            std::vector<umod64> &values) {
+  std::ifstream file(_path + "/state.bin", std::ios::binary);
+  if (!file || read_binary<uint64_t>(file) != STATE_MAGIC)
+    return false;
+  if (read_binary<uint64_t>(file) != hash)
+    throw std::runtime_error("checkpoint " + _path +
+                             " belongs to another family");
+  if (read_binary<uint64_t>(file) != modulus)
+    throw std::runtime_error("checkpoint " + _path +
+                             " belongs to another field");
+  _modulus = modulus;
+  values.resize(read_binary<uint32_t>(file));
+  for (auto &value : values)
+    value = umod64{read_binary<uint64>(file)};
+  return (bool)file;
+}
+
+std::string Checkpoint::table_path(unsigned sector) const {
+  return _path + "/sector_" + std::to_string(sector) + ".bin";
+}
+
+bool Checkpoint::completed(unsigned sector) const {
+  if (!_resume || !std::filesystem::exists(table_path(sector)))
+    return false;
+  try {
+    ReductionTable table(table_path(sector));
+    return table.sector() == sector && !table.rational() &&
+           table.modulus() == _modulus;
+  } catch (std::runtime_error &) {
+    return false;
+  }
+}
+
+void Checkpoint::complete(unsigned sector, const std::string &table) const {
+  // linked instead of written twice, copied across file systems
+  std::string tmp = table_path(sector) + ".tmp";
+  std::filesystem::remove(tmp);
+  std::error_code error;
+  std::filesystem::create_hard_link(table, tmp, error);
+  if (error)
+    std::filesystem::copy_file(table, tmp);
+  std::filesystem::rename(tmp, table_path(sector));
+  std::filesystem::remove(_path + "/snapshot_" + std::to_string(sector) +
+                          ".bin");
+}
+
+template <typename T>
+void Checkpoint::save_snapshot(unsigned sector, unsigned next,
+                               const EliminationCounters &counters,
+                               const std::vector<EquationMod<T>> &gauss) const {
+  _write(_path + "/snapshot_" + std::to_string(sector) + ".bin",
+         [&](std::ofstream &file) {
+           write_binary(file, SNAPSHOT_MAGIC);
+           write_binary<uint32_t>(file, sector);
+           write_binary<uint32_t>(file, next);
+           write_binary(file, counters.zero);
+           write_binary(file, counters.eliminations);
+           write_binary(file, counters.fillIn);
+           write_binary<uint32_t>(file, gauss.size());
+           for (const auto &equation : gauss) {
+             write_binary<uint32_t>(file, equation.eqnum);
+             write_binary<uint32_t>(file, equation.size());
+             for (unsigned i = 0; i < equation.size(); ++i) {
+               write_binary<uint32_t>(file, equation[i]);
+               write_binary(file, equation.coeff(i).value());
+             }
+           }
+         });
+}
+
+template <typename T>
+unsigned Checkpoint::load_snapshot(unsigned sector,
+                                   EliminationCounters &counters,
+                                   std::vector<EquationMod<T>> &gauss) const {
+  if (!_resume)
+    return 0;
+  std::ifstream file(_path + "/snapshot_" + std::to_string(sector) + ".bin",
+                     std::ios::binary);
+  if (!file || read_binary<uint64_t>(file) != SNAPSHOT_MAGIC ||
+      read_binary<uint32_t>(file) != sector)
+    return 0;
+
+  auto next = read_binary<uint32_t>(file);
+  EliminationCounters saved;
+  saved.zero = read_binary<uint64_t>(file);
+  saved.eliminations = read_binary<uint64_t>(file);
+  saved.fillIn = read_binary<uint64_t>(file);
+  std::vector<EquationMod<T>> rows(read_binary<uint32_t>(file));
+  for (auto &equation : rows) {
+    equation.eqnum = read_binary<uint32_t>(file);
+    auto size = read_binary<uint32_t>(file);
+    for (unsigned i = 0; i < size; ++i) {
+      auto integral = read_binary<uint32_t>(file);
+      equation.insert(integral, T{read_binary<uint64>(file)});
+    }
+  }
+  if (!file)
+    return 0;
+  gauss = std::move(rows);
+  counters = saved;
+  return next;
+}
+
+template void
+Checkpoint::save_snapshot(unsigned, unsigned, const EliminationCounters &,
+                          const std::vector<EquationMod<umod64>> &) const;
+template void
+Checkpoint::save_snapshot(unsigned, unsigned, const EliminationCounters &,
+                          const std::vector<EquationMod<umod50>> &) const;
+template void
+Checkpoint::save_snapshot(unsigned, unsigned, const EliminationCounters &,
+                          const std::vector<EquationMod<umod31>> &) const;
+template unsigned
+Checkpoint::load_snapshot(unsigned, EliminationCounters &,
+                          std::vector<EquationMod<umod64>> &) const;
+template unsigned
+Checkpoint::load_snapshot(unsigned, EliminationCounters &,
+                          std::vector<EquationMod<umod50>> &) const;
+template unsigned
+Checkpoint::load_snapshot(unsigned, EliminationCounters &,
+                          std::vector<EquationMod<umod31>> &) const;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "arith/umod.h"
+
+#include "equation.h"
+#include "table.h"
+
+// counters of a running elimination, saved with its snapshots
+struct EliminationCounters {
+  // equations reduced to zero
+  uint64_t zero = 0;
+  // row reductions and the terms they created
+  uint64_t eliminations = 0;
+  uint64_t fillIn = 0;
+};
+
+// checkpoints of the sector reductions in a directory
+//  state.bin:          family hash, prime and values of the symbols
+//  sector_<id>.bin:    reduction table of a completed sector
+//  snapshot_<id>.bin:  gauss rows and counters of a running sector
+class Checkpoint {
+public:
+  // disabled checkpoints
+  Checkpoint() = default;
+
+  // interval: seconds between snapshots of a running sector
+  Checkpoint(std::string path, unsigned interval, bool resume)
+      : _path(std::move(path)), _interval(interval), _resume(resume) {}
+
+  [[nodiscard]] bool enabled() const { return !_path.empty(); }
+
+  // resume a previous run
+  [[nodiscard]] bool resume() const { return _resume; }
+
+  // remove checkpoints of a previous run
+  void reset() const;
+
+  // save the state shared by all sectors
+  // modulus: prime of the reduction field
+  void save_state(uint64_t hash, uint64_t modulus,
+                  const std::vector<umod64> &values);
+  // load the shared state, throws if it belongs to another family or field
+  // returns false if there is no state
+  bool load_state(uint64_t hash, uint64_t modulus,
+                  std::vector<umod64> &values);
+
+  // path of the reduction table of a completed sector
+  [[nodiscard]] std::string table_path(unsigned sector) const;
+  // check if the sector was completed in a previous run over the same field
+  [[nodiscard]] bool completed(unsigned sector) const;
+  // mark the sector as completed with its written reduction table
+  void complete(unsigned sector, const std::string &table) const;
+
+  // check if a snapshot should be taken
+  [[nodiscard]] bool snapshot_due(
+      std::chrono::steady_clock::time_point last) const {
+    return std::chrono::steady_clock::now() - last >=
+           std::chrono::seconds(_interval);
+  }
+  // save the gauss rows and the counters of a running sector
+  // next: the number of the next equation in the sorted system
+  template <typename T>
+  void save_snapshot(unsigned sector, unsigned next,
+                     const EliminationCounters &counters,
+                     const std::vector<EquationMod<T>> &gauss) const;
+  // load the gauss rows and the counters of a running sector
+  // returns the number of the next equation, 0 if there is no snapshot
+  template <typename T>
+  unsigned load_snapshot(unsigned sector, EliminationCounters &counters,
+                         std::vector<EquationMod<T>> &gauss) const;
+
+private:
+  // write a file atomically through a temporary file
+  template <typename F>
+  void _write(const std::string &path, F writer) const;
+
+private:
+  std::string _path;
+  unsigned _interval = 600;
+  bool _resume = false;
+  // prime of the reduction field of the state
+  uint64_t _modulus = 0;
+};
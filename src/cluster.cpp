@@ -0,0 +1,436 @@
+#include "cluster.h"
+#include "log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// a sector is given up after failing this many times
+static const unsigned MAX_ATTEMPTS = 3;
+// seconds a new connection has to introduce itself
+static const unsigned HANDSHAKE_TIMEOUT = 10;
+// payload of a Hello, hash and prime
+static const uint64_t HELLO_SIZE = 2 * sizeof(uint64_t);
+
+static std::runtime_error socket_error(const std::string &what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// socket of an address, bound or connected
+static int open_socket(const std::string &address, bool listen,
+                       std::string &path) {
+  if (address.starts_with("unix:")) {
+    path = address.substr(5);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+      throw std::runtime_error("socket path " + path + " is too long");
+    std::strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      throw socket_error("cannot create socket");
+    if (listen)
+      unlink(path.c_str());
+    int status = listen ? bind(fd, (sockaddr *)&addr, sizeof(addr))
+                        : connect(fd, (sockaddr *)&addr, sizeof(addr));
+    if (status != 0) {
+      close(fd);
+      throw socket_error("cannot " + std::string(listen ? "bind" : "connect") +
+                         " to " + address);
+    }
+    return fd;
+  }
+
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos)
+    throw std::runtime_error("address " + address +
+                             " is neither unix:PATH nor HOST:PORT");
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listen ? AI_PASSIVE : 0;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints,
+                  &result) != 0)
+    throw std::runtime_error("cannot resolve " + address);
+
+  int fd = -1;
+  for (addrinfo *info = result; info; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0)
+      continue;
+    int one = 1;
+    if (listen)
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    else
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if ((listen ? bind(fd, info->ai_addr, info->ai_addrlen)
+                : connect(fd, info->ai_addr, info->ai_addrlen)) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  if (fd < 0)
+    throw socket_error("cannot " + std::string(listen ? "bind" : "connect") +
+                       " to " + address);
+  return fd;
+}
+
+// Connection
+
+Connection::~Connection() {
+  if (_fd >= 0)
+    close(_fd);
+}
+
+Connection Connection::connect(const std::string &address) {
+  std::string path;
+  return Connection(open_socket(address, false, path));
+}
+
+void Connection::send(Message type, const std::string &payload) {
+  PayloadWriter header;
+  header.put((uint32_t)type);
+  header.put<uint64_t>(payload.size());
+  for (const std::string *data : {&header.data(), &payload}) {
+    size_t sent = 0;
+    while (sent < data->size()) {
+      ssize_t n = ::send(_fd, data->data() + sent, data->size() - sent,
+                         MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw socket_error("connection lost");
+      sent += n;
+    }
+  }
+}
+
+bool Connection::receive(Message &type, std::string &payload) {
+  // read bytes, false on the end of the stream
+  auto read_all = [this](char *data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+      ssize_t n = recv(_fd, data + received, size - received, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        throw socket_error("connection lost");
+      if (n == 0)
+        return false;
+      received += n;
+    }
+    return true;
+  };
+
+  char header[sizeof(uint32_t) + sizeof(uint64_t)];
+  if (!read_all(header, sizeof(header)))
+    return false;
+  uint32_t rawType;
+  uint64_t size;
+  std::memcpy(&rawType, header, sizeof(rawType));
+  std::memcpy(&size, header + sizeof(rawType), sizeof(size));
+  if (rawType > (uint32_t)Message::Done || size > MAX_PAYLOAD)
+    throw std::runtime_error("invalid message");
+  type = (Message)rawType;
+  // grown as the bytes arrive, not by the announced size
+  const size_t chunk = 1 << 20;
+  payload.clear();
+  while (payload.size() < size) {
+    size_t received = payload.size();
+    payload.resize(received + std::min<uint64_t>(chunk, size - received));
+    if (!read_all(payload.data() + received, payload.size() - received))
+      return false;
+  }
+  return true;
+}
+
+bool Connection::try_receive(Message &type, std::string &payload,
+                             uint64_t limit) {
+  const size_t headerSize = sizeof(uint32_t) + sizeof(uint64_t);
+  while (true) {
+    // the header first, then the payload, never past the message
+    size_t want = headerSize;
+    if (_partial.size() >= headerSize) {
+      uint64_t size;
+      std::memcpy(&size, _partial.data() + sizeof(uint32_t), sizeof(size));
+      if (size > std::min(limit, MAX_PAYLOAD))
+        throw std::runtime_error("invalid message");
+      want += size;
+    }
+    if (_partial.size() == want)
+      break;
+    char data[4096];
+    ssize_t n = recv(_fd, data, std::min(sizeof(data), want - _partial.size()),
+                     MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    if (n < 0)
+      throw socket_error("connection lost");
+    if (n == 0)
+      throw std::runtime_error("connection closed");
+    _partial.append(data, n);
+  }
+
+  uint32_t rawType;
+  std::memcpy(&rawType, _partial.data(), sizeof(rawType));
+  if (rawType > (uint32_t)Message::Done)
+    throw std::runtime_error("invalid message");
+  type = (Message)rawType;
+  payload = _partial.substr(headerSize);
+  _partial.clear();
+  return true;
+}
+
+// Listener
+
+Listener::Listener(const std::string &address) {
+  _fd = open_socket(address, true, _path);
+  if (listen(_fd, 64) != 0) {
+    close(_fd);
+    throw socket_error("cannot listen on " + address);
+  }
+}
+
+Listener::~Listener() {
+  close(_fd);
+  if (!_path.empty())
+    unlink(_path.c_str());
+}
+
+Connection Listener::accept() {
+  int fd;
+  do
+    fd = ::accept(_fd, nullptr, nullptr);
+  while (fd < 0 && errno == EINTR);
+  if (fd < 0)
+    throw socket_error("cannot accept a worker");
+  return Connection(fd);
+}
+
+// Coordinator
+
+void Coordinator::run(
+    const std::vector<unsigned> &sectors,
+    const std::function<void(unsigned, const std::string &)> &store) {
+  std::deque<unsigned> pending(sectors.begin(), sectors.end());
+  std::map<unsigned, unsigned> attempts;
+  size_t done = 0;
+
+  // connected workers and their jobs
+  struct Worker {
+    Connection connection;
+    bool busy = false;
+    unsigned sector = 0;
+  };
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  // accepted connections waiting for their Hello, polled with the workers
+  // so that a silent client does not stall the others
+  struct Joining {
+    Connection connection;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  std::vector<std::unique_ptr<Joining>> joining;
+
+  // check the Hello of a new connection and send the setup
+  auto handshake = [this](Connection &connection, Message type,
+                          const std::string &payload) {
+    if (type != Message::Hello)
+      return false;
+    PayloadReader hello(payload);
+    PayloadWriter reply;
+    if (hello.get<uint64_t>() != _hash || hello.get<uint64_t>() != _modulus) {
+      reply.put<uint32_t>(0);
+      reply.put_string("worker belongs to another family or field");
+      connection.send(Message::Failed, reply.data());
+      return false;
+    }
+    reply.put<uint32_t>(_values.size());
+    for (const auto &value : _values)
+      reply.put<uint64_t>(value.value());
+    connection.send(Message::Setup, reply.data());
+    return true;
+  };
+
+  // a job was not completed, give it to another worker
+  auto retry = [&](unsigned sector, const std::string &reason) {
+    LOG_WARNING("sector " << sector << " failed: " << reason);
+    if (++attempts[sector] >= MAX_ATTEMPTS)
+      throw std::runtime_error("sector " + std::to_string(sector) + " failed " +
+                               std::to_string(MAX_ATTEMPTS) + " times");
+    pending.push_front(sector);
+  };
+
+  LOG_INFO("\n  Waiting for workers on the coordinator socket");
+  while (done < sectors.size()) {
+    // give the pending jobs to the idle workers
+    for (auto &worker : workers) {
+      if (worker->busy || pending.empty())
+        continue;
+      PayloadWriter job;
+      job.put<uint32_t>(pending.front());
+      try {
+        worker->connection.send(Message::Job, job.data());
+      } catch (std::runtime_error &) {
+        // found dead on the next poll
+        continue;
+      }
+      worker->busy = true;
+      worker->sector = pending.front();
+      pending.pop_front();
+    }
+
+    std::vector<pollfd> fds{{_listener.fd(), POLLIN, 0}};
+    for (const auto &worker : workers)
+      fds.push_back({worker->connection.fd(), POLLIN, 0});
+    // wake up for the first handshake deadline
+    int timeout = -1;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &client : joining) {
+      fds.push_back({client->connection.fd(), POLLIN, 0});
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          client->deadline - now);
+      int ms = (int)std::max<int64_t>(0, left.count());
+      timeout = timeout < 0 ? ms : std::min(timeout, ms);
+    }
+    size_t nworkers = workers.size();
+    if (poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      throw socket_error("poll failed");
+    }
+
+    // results and failures of the workers
+    for (size_t i = nworkers; i-- > 0;) {
+      if (fds[i + 1].revents == 0)
+        continue;
+      Worker &worker = *workers[i];
+      Message type;
+      std::string payload;
+      // read without blocking, a large table arrives over several polls
+      bool alive = true;
+      try {
+        if (!worker.connection.try_receive(type, payload))
+          continue;
+      } catch (std::exception &) {
+        alive = false;
+      }
+      if (!alive) {
+        LOG_WARNING("a worker disconnected");
+        if (worker.busy)
+          retry(worker.sector, "worker disconnected");
+        workers.erase(workers.begin() + (long)i);
+        continue;
+      }
+      if (!worker.busy)
+        continue;
+      worker.busy = false;
+      if (type == Message::Result) {
+        try {
+          PayloadReader reader(payload);
+          auto sector = reader.get<uint32_t>();
+          if (sector != worker.sector)
+            throw std::runtime_error("result of another sector");
+          store(sector, reader.get_string());
+          ++done;
+        } catch (std::exception &e) {
+          retry(worker.sector, e.what());
+        }
+      } else if (type == Message::Failed) {
+        std::string reason = "failed message truncated";
+        try {
+          PayloadReader reader(payload);
+          reader.get<uint32_t>();
+          reason = reader.get_string();
+        } catch (std::exception &) {
+        }
+        retry(worker.sector, reason);
+      } else
+        retry(worker.sector, "unexpected message");
+    }
+
+    // handshakes of the new connections, read without blocking as the Hello
+    // arrives, a client silent past its deadline is dropped
+    now = std::chrono::steady_clock::now();
+    for (size_t i = joining.size(); i-- > 0;) {
+      Joining &client = *joining[i];
+      bool joined = false;
+      if (fds[1 + nworkers + i].revents != 0) {
+        Message type;
+        std::string payload;
+        try {
+          if (!client.connection.try_receive(type, payload, HELLO_SIZE)) {
+            if (now < client.deadline)
+              continue;
+          } else
+            joined = handshake(client.connection, type, payload);
+        } catch (std::exception &) {
+        }
+      } else if (now < client.deadline)
+        continue;
+      if (joined) {
+        workers.emplace_back(
+            std::make_unique<Worker>(Worker{std::move(client.connection)}));
+        LOG_DEBUG("worker joined, " << workers.size() << " connected");
+      } else
+        LOG_DEBUG("a connection failed the handshake");
+      joining.erase(joining.begin() + (long)i);
+    }
+
+    // new connections
+    if (fds[0].revents & POLLIN) {
+      joining.emplace_back(std::make_unique<Joining>(
+          Joining{_listener.accept(), std::chrono::steady_clock::now() +
+                                          std::chrono::seconds(
+                                              HANDSHAKE_TIMEOUT)}));
+    }
+  }
+
+  for (auto &worker : workers) {
+    try {
+      worker->connection.send(Message::Done, "");
+    } catch (std::runtime_error &) {
+    }
+  }
+}
+
+std::vector<umod64> join_coordinator(Connection &connection, uint64_t hash,
+                                     uint64_t modulus) {
+  PayloadWriter hello;
+  hello.put(hash);
+  hello.put(modulus);
+  connection.send(Message::Hello, hello.data());
+
+  Message type;
+  std::string payload;
+  if (!connection.receive(type, payload))
+    throw std::runtime_error("coordinator closed the connection");
+  PayloadReader reader(payload);
+  if (type == Message::Failed) {
+    reader.get<uint32_t>();
+    throw std::runtime_error(reader.get_string());
+  }
+  if (type != Message::Setup)
+    throw std::runtime_error("unexpected message from the coordinator");
+  std::vector<umod64> values(reader.get<uint32_t>());
+  for (auto &value : values)
+    value = umod64{reader.get<uint64_t>()};
+  return values;
+}
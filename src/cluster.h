@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arith/umod.h"
+
+// messages between the coordinator and the workers
+//  Hello:  worker -> coordinator, family hash and prime of the field
+//  Setup:  coordinator -> worker, values of the symbols
+//  Job:    coordinator -> worker, sector to reduce
+//  Result: worker -> coordinator, sector and its reduction table
+//  Failed: either way, sector and error message
+//  Done:   coordinator -> worker, no more jobs
+enum class Message : uint32_t { Hello, Setup, Job, Result, Failed, Done };
+
+// largest payload accepted from a peer, a message announcing more is invalid
+const uint64_t MAX_PAYLOAD = 1ul << 34;
+
+// connected stream socket
+// a message is a uint32 type, a uint64 length and the payload
+// addresses are unix:PATH for unix sockets or HOST:PORT for tcp
+class Connection {
+public:
+  explicit Connection(int fd) : _fd(fd) {}
+
+  Connection(const Connection &) = delete;
+
+  Connection &operator=(const Connection &) = delete;
+
+  Connection(Connection &&other) noexcept
+      : _fd(other._fd), _partial(std::move(other._partial)) {
+    other._fd = -1;
+  }
+
+  ~Connection();
+
+  // connect to a listening address, throws if it fails
+  static Connection connect(const std::string &address);
+
+  // throws if the connection is broken
+  void send(Message type, const std::string &payload);
+  // receive the next message, false if the peer closed the connection
+  bool receive(Message &type, std::string &payload);
+  // read the available bytes of the next message without blocking, true
+  // once it is complete, throws if the connection is broken or closed
+  // limit: largest payload accepted
+  bool try_receive(Message &type, std::string &payload,
+                   uint64_t limit = MAX_PAYLOAD);
+
+  [[nodiscard]] int fd() const { return _fd; }
+
+private:
+  int _fd = -1;
+  // bytes of a message read by try_receive
+  std::string _partial;
+};
+
+// listening stream socket
+class Listener {
+public:
+  explicit Listener(const std::string &address);
+
+  Listener(const Listener &) = delete;
+
+  Listener &operator=(const Listener &) = delete;
+
+  ~Listener();
+
+  Connection accept();
+
+  [[nodiscard]] int fd() const { return _fd; }
+
+private:
+  int _fd = -1;
+  // path of a unix socket, removed on close
+  std::string _path;
+};
+
+// encode the payload of a message
+class PayloadWriter {
+public:
+  template <typename T> void put(const T &value) {
+    _data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void put_string(const std::string &value) {
+    put<uint64_t>(value.size());
+    _data += value;
+  }
+
+  [[nodiscard]] const std::string &data() const { return _data; }
+
+private:
+  std::string _data;
+};
+
+// decode the payload of a message, throws if it is truncated
+class PayloadReader {
+public:
+  explicit PayloadReader(const std::string &data) : _data(data) {}
+
+  template <typename T> T get() {
+    T value;
+    std::memcpy(&value, _take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string get_string() {
+    auto size = get<uint64_t>();
+    return {_take(size), size};
+  }
+
+private:
+  const char *_take(size_t bytes) {
+    if (_data.size() - _offset < bytes)
+      throw std::runtime_error("truncated message");
+    _offset += bytes;
+    return _data.data() + _offset - bytes;
+  }
+
+private:
+  const std::string &_data;
+  size_t _offset = 0;
+};
+
+// distributes the sector jobs of a reduction to worker processes
+// a job of a worker that fails or disconnects is given to another worker
+class Coordinator {
+public:
+  // hash and modulus: family and field the workers must match
+  // values: values of the symbols sent to the workers
+  Coordinator(const std::string &address, uint64_t hash, uint64_t modulus,
+              std::vector<umod64> values)
+      : _listener(address), _hash(hash), _modulus(modulus),
+        _values(std::move(values)) {}
+
+  // reduce the sectors on the workers, store(sector, table) is called with
+  // the reduction table of each sector, throws if a sector fails too often
+  void run(const std::vector<unsigned> &sectors,
+           const std::function<void(unsigned, const std::string &)> &store);
+
+private:
+  Listener _listener;
+  uint64_t _hash;
+  uint64_t _modulus;
+  std::vector<umod64> _values;
+};
+
+// join a coordinator as a worker, returns the values of the symbols
+// throws if the coordinator reduces another family or field
+std::vector<umod64> join_coordinator(Connection &, uint64_t hash,
+                                     uint64_t modulus);
@@ -0,0 +1,162 @@
+#include "convert.h"
+
+#include <map>
+#include <sstream>
+
+#include "cln/rational.h"
+
+namespace {
+typedef std::map<GiNaC::ex, unsigned, GiNaC::ex_is_less> VarMap;
+
+// numerator and denominator of a rational numeric
+std::pair<cln::cl_I, cln::cl_I> split_rational(const GiNaC::numeric &num) {
+  if (!num.is_rational())
+    throw std::runtime_error("coefficient is not a rational number");
+  const cln::cl_RA &rational = cln::The(cln::cl_RA)(num.to_cl_N());
+  return {cln::numerator(rational), cln::denominator(rational)};
+}
+
+// push the terms of ex into poly, poly is not canonicalized
+void collect_terms(const GiNaC::ex &ex, const VarMap &vars,
+                   SparsePoly<Rational> &poly) {
+  unsigned nvars = poly.nvars();
+
+  SparsePoly<Rational> res(nvars);
+  if (is_a<GiNaC::numeric>(ex))
+    res = SparsePoly<Rational>::constant(
+        nvars, to_rational(GiNaC::ex_to<GiNaC::numeric>(ex)));
+  else if (is_a<GiNaC::symbol>(ex)) {
+    auto it = vars.find(ex);
+    if (it == vars.end()) {
+      std::stringstream ss;
+      ss << ex;
+      throw std::runtime_error("unexpected symbol " + ss.str() +
+                               " in polynomial");
+    }
+    res = SparsePoly<Rational>::variable(nvars, it->second);
+  } else if (is_a<GiNaC::add>(ex)) {
+    // the terms of a sum are collected without intermediate merges
+    for (size_t i = 0; i < ex.nops(); ++i)
+      collect_terms(ex.op(i), vars, poly);
+    return;
+  } else if (is_a<GiNaC::mul>(ex)) {
+    res = SparsePoly<Rational>::constant(nvars, 1);
+    for (size_t i = 0; i < ex.nops(); ++i) {
+      SparsePoly<Rational> factor(nvars);
+      collect_terms(ex.op(i), vars, factor);
+      factor.canonicalize();
+      res *= factor;
+    }
+  } else if (is_a<GiNaC::power>(ex)) {
+    GiNaC::ex exponent = ex.op(1);
+    if (!is_a<GiNaC::numeric>(exponent) ||
+        !GiNaC::ex_to<GiNaC::numeric>(exponent).is_nonneg_integer())
+      throw std::runtime_error("expression is not a polynomial");
+    SparsePoly<Rational> base(nvars);
+    collect_terms(ex.op(0), vars, base);
+    base.canonicalize();
+    res = SparsePoly<Rational>::constant(nvars, 1);
+    for (long i = GiNaC::ex_to<GiNaC::numeric>(exponent).to_long(); i > 0; --i)
+      res *= base;
+  } else
+    throw std::runtime_error("expression is not a polynomial");
+
+  for (unsigned i = 0; i < res.size(); ++i)
+    poly.push_term(res.exponents(i), res.coeff(i));
+}
+} // namespace
+
+void to_fmpz(fmpz_t res, const cln::cl_I &num) {
+  if (cln::integer_length(num) < 64) {
+    fmpz_set_si(res, cln::cl_I_to_long(num));
+    return;
+  }
+
+  // copy the limbs of the absolute value, least significant first
+  cln::cl_I absNum = cln::abs(num);
+  uintptr_t nlimbs = (cln::integer_length(absNum) + 63) / 64;
+  std::vector<ulong> limbs(nlimbs);
+  for (uintptr_t i = 0; i < nlimbs; ++i)
+    limbs[i] = cln::cl_I_to_UQ(cln::ldb(absNum, cln::cl_byte(64, 64 * i)));
+  fmpz_set_ui_array(res, limbs.data(), (slong)nlimbs);
+  if (cln::minusp(num))
+    fmpz_neg(res, res);
+}
+
+Rational to_rational(const GiNaC::numeric &num) {
+  auto [numer, denom] = split_rational(num);
+
+  fmpz_t fnumer, fdenom;
+  fmpz_init(fnumer);
+  fmpz_init(fdenom);
+  to_fmpz(fnumer, numer);
+  to_fmpz(fdenom, denom);
+  Rational res(fnumer, fdenom);
+  fmpz_clear(fnumer);
+  fmpz_clear(fdenom);
+  return res;
+}
+
+SparsePoly<Rational> to_poly(const GiNaC::ex &ex,
+                             const std::vector<GiNaC::ex> &vars) {
+  VarMap varMap;
+  for (unsigned i = 0; i < vars.size(); ++i)
+    varMap[vars[i]] = i;
+
+  SparsePoly<Rational> poly(vars.size());
+  collect_terms(ex, varMap, poly);
+  poly.canonicalize();
+  return poly;
+}
+
+std::vector<GiNaC::ex> linear_coeffs(const GiNaC::ex &ex,
+                                     const std::vector<GiNaC::symbol> &syms) {
+  VarMap symMap;
+  for (unsigned i = 0; i < syms.size(); ++i)
+    symMap[syms[i]] = i;
+
+  // terms of each coefficient, the last one is the constant
+  std::vector<GiNaC::exvector> terms(syms.size() + 1);
+  auto nonlinear = [&ex]() {
+    std::stringstream ss;
+    ss << ex;
+    return std::runtime_error("expression " + ss.str() + " is not linear");
+  };
+  auto isPowerOfSym = [&symMap](const GiNaC::ex &factor) {
+    return is_a<GiNaC::power>(factor) && symMap.contains(factor.op(0));
+  };
+  auto collect = [&](const GiNaC::ex &term) {
+    if (auto it = symMap.find(term); it != symMap.end())
+      terms[it->second].emplace_back(1);
+    else if (is_a<GiNaC::mul>(term)) {
+      unsigned index = syms.size();
+      GiNaC::exvector factors;
+      for (size_t i = 0; i < term.nops(); ++i) {
+        GiNaC::ex factor = term.op(i);
+        if (auto it = symMap.find(factor); it != symMap.end()) {
+          if (index != syms.size())
+            throw nonlinear();
+          index = it->second;
+        } else if (isPowerOfSym(factor))
+          throw nonlinear();
+        else
+          factors.push_back(factor);
+      }
+      terms[index].emplace_back(GiNaC::mul(factors));
+    } else if (isPowerOfSym(term))
+      throw nonlinear();
+    else
+      terms.back().push_back(term);
+  };
+
+  if (is_a<GiNaC::add>(ex))
+    for (size_t i = 0; i < ex.nops(); ++i)
+      collect(ex.op(i));
+  else if (!ex.is_zero())
+    collect(ex);
+
+  std::vector<GiNaC::ex> coeffs;
+  for (const auto &sum : terms)
+    coeffs.emplace_back(GiNaC::add(sum));
+  return coeffs;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include "arith/poly.h"
+#include "arith/rational.h"
+#include "cln/integer.h"
+#include "ginac/ginac.h"
+
+// convert a CLN integer to fmpz
+void to_fmpz(fmpz_t, const cln::cl_I &);
+
+// convert a rational GiNaC numeric to a Rational
+Rational to_rational(const GiNaC::numeric &);
+
+// convert a polynomial expression to a sparse polynomial
+// the i-th variable of the polynomial is vars[i]
+// throws if the expression contains other symbols or is not a polynomial
+SparsePoly<Rational> to_poly(const GiNaC::ex &,
+                             const std::vector<GiNaC::ex> &vars);
+
+// coefficients of an expanded expression linear in syms
+// [c_1, ..., c_n, c_0] for c_1*syms[0] + ... + c_n*syms[n-1] + c_0
+// the expression is walked once, throws if it is not linear in syms
+std::vector<GiNaC::ex> linear_coeffs(const GiNaC::ex &,
+                                     const std::vector<GiNaC::symbol> &syms);
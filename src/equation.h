@@ -3,13 +3,150 @@
 #include <map>
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <span>
+#include <vector>
 
 #include "utils.h"
+#include "arith/ratfun.h"
 #include "arith/umod.h"
-#include "ginac/ginac.h"
+#include "arith/umodvec.h"
 
-// equation over finite field
-class EquationFF {
+// line number of an integral without a pivot row
+const unsigned NO_PIVOT = std::numeric_limits<unsigned>::max();
+
+// scratch of EquationMod::reduce
+// a dense accumulator over the integral weights and a max-heap of the
+// weights touched by the current equation
+// the accumulator is 128 bits wide and holds unreduced sums of products,
+// at most T::DELAYED_PRODUCTS of them are added before the sum is reduced
+template <typename T> class SparseAccumulator {
+public:
+  SparseAccumulator() = default;
+
+  explicit SparseAccumulator(unsigned nweights)
+      : _dense(nweights, 0), _pending(nweights, 0), _touched(nweights, false) {}
+
+  // row reductions by a pivot row
+  uint64_t eliminations = 0;
+  // terms created by the reductions
+  uint64_t fillIn = 0;
+
+  // reduce a row by all the pivot rows in one pass and normalize
+  // lineNumber: line number of the pivot row of each weight
+  // pivot(line): terms of a normalized pivot row, in descending weights
+  // the columns are visited from the largest weight, a column with a pivot
+  // row is eliminated, the others are the result in weights() and coeffs()
+  // in descending order
+  template <typename Pivot>
+  void reduce(std::span<const std::pair<unsigned, T>> row,
+              const std::vector<unsigned> &lineNumber, Pivot pivot) {
+    for (const auto &[weight, coeff] : row) {
+      _dense[weight] = coeff.value();
+      _touch(weight);
+    }
+    _weights.clear();
+    _sums.clear();
+
+    while (!_heap.empty()) {
+      auto [weight, sum] = _pop();
+      if (sum == 0)
+        continue;
+      // the pivot rows of the later columns do not reach this column, its
+      // sum is final and reduced with the others after the pass
+      if (lineNumber[weight] == NO_PIVOT) {
+        _weights.push_back(weight);
+        _sums.push_back(sum);
+        continue;
+      }
+      T scale = T::reduce(sum);
+      if (scale == 0)
+        continue;
+      // the leading coefficient of the pivot row is one
+      std::span<const std::pair<unsigned, T>> terms = pivot(lineNumber[weight]);
+      T negScale = -scale;
+      for (size_t i = 1; i < terms.size(); ++i) {
+        unsigned column = terms[i].first;
+        if (!_touched[column])
+          ++fillIn;
+        _add_mul(column, negScale, terms[i].second);
+        _touch(column);
+      }
+      ++eliminations;
+    }
+
+    // drain the result columns in one batch and drop the multiples of the
+    // prime
+    _coeffs.resize(_sums.size());
+    vec_reduce(_coeffs.data(), _sums.data(), _sums.size());
+    size_t size = 0;
+    for (size_t i = 0; i < _coeffs.size(); ++i)
+      if (_coeffs[i] != 0) {
+        _weights[size] = _weights[i];
+        _coeffs[size++] = _coeffs[i];
+      }
+    _weights.resize(size);
+    _coeffs.resize(size);
+
+    if (!_weights.empty() && _coeffs[0] != 1)
+      vec_scale(_coeffs.data(), T{1} / _coeffs[0], _coeffs.size());
+  }
+
+  // result of the last reduce
+  [[nodiscard]] const std::vector<unsigned> &weights() const {
+    return _weights;
+  }
+  [[nodiscard]] const std::vector<T> &coeffs() const { return _coeffs; }
+
+private:
+  // add a weight to the heap if it is not there yet
+  void _touch(unsigned weight) {
+    if (!_touched[weight]) {
+      _touched[weight] = true;
+      _heap.push_back(weight);
+      std::push_heap(_heap.begin(), _heap.end());
+    }
+  }
+
+  // remove the largest weight from the heap, returns it and its unreduced
+  // sum
+  std::pair<unsigned, uint128> _pop() {
+    std::pop_heap(_heap.begin(), _heap.end());
+    unsigned weight = _heap.back();
+    _heap.pop_back();
+    _touched[weight] = false;
+    uint128 sum = _dense[weight];
+    _dense[weight] = 0;
+    _pending[weight] = 0;
+    return {weight, sum};
+  }
+
+  // add a * b to the weight
+  void _add_mul(unsigned weight, T a, T b) {
+    if (_pending[weight] == T::DELAYED_PRODUCTS) {
+      _dense[weight] = T::reduce(_dense[weight]).value();
+      _pending[weight] = 0;
+    }
+    _dense[weight] += a.mul_wide(b);
+    ++_pending[weight];
+  }
+
+private:
+  std::vector<uint128> _dense;
+  // unreduced products in each sum
+  std::vector<unsigned char> _pending;
+  std::vector<char> _touched;
+  std::vector<unsigned> _heap;
+  // unreduced sums of the columns without a pivot row
+  std::vector<uint128> _sums;
+  // weights and coefficients of the reduced equation
+  std::vector<unsigned> _weights;
+  std::vector<T> _coeffs;
+};
+
+// equation over a finite field
+// T: umod64, umod50 or umod31
+template <typename T> class EquationMod {
 public:
   unsigned operator[](unsigned i) const {
     return _eq[i].first;
@@ -19,12 +156,12 @@ public:
     return _eq[i].first;
   }
 
- [[nodiscard]] umod64 coeff(unsigned i) const {
+ [[nodiscard]] T coeff(unsigned i) const {
     return _eq[i].second;
   }
 
   // insert a new item
-  void insert(unsigned integral, umod64 coeff) {
+  void insert(unsigned integral, T coeff) {
     _eq.emplace_back(integral, coeff);
   }
 
@@ -39,7 +176,7 @@ public:
   }
 
   // get the first coefficient
-  umod64 first_coeff() {
+  T first_coeff() {
     return _eq[0].second;
   }
 
@@ -48,58 +185,36 @@ public:
     return _eq.empty();
   }
 
+  // estimated memory in bytes
+  [[nodiscard]] size_t bytes() const {
+    return sizeof(EquationMod) + _eq.capacity() * sizeof(_eq[0]);
+  }
+
   void sort() {
     std::sort(_eq.begin(), _eq.end(),
-              [](const std::pair<unsigned, umod64>& i, const std::pair<unsigned, umod64>& j){
+              [](const std::pair<unsigned, T>& i, const std::pair<unsigned, T>& j){
                   return i.first > j.first;
     });
   }
 
-  // clear zero items
-  void erase_zero() {
-    std::erase_if(_eq, [](const auto &item) { return item.second == 0; });
-  }
-
-  // normalize: set the first coeff to one
-  void normalize() {
-    umod64 scale = _eq[0].second;
-    for (auto &item: _eq)
-      item.second /= scale;
-  }
-
-  // gauss elimination: eliminate the other equation from this one
-  // it is assumed that the other equation has been normalized
-  void eliminate(const EquationFF &other, unsigned index) {
-    std::vector<std::pair<unsigned, umod64>> eq;
-
-    umod64 scale = _eq[index].second;
-    unsigned iother = 0, ithis = 0;
-    while (iother < other.size() && ithis < _eq.size()) {
-      if(other[iother] > _eq[ithis].first) {
-        eq.emplace_back(other[iother], -scale * other._eq[iother].second);
-        ++iother;
-      }
-      else if (other[iother] == _eq[ithis].first) {
-        umod64 coeff = _eq[ithis].second - scale * other.coeff(iother);
-        if (coeff != 0)
-          eq.emplace_back(_eq[ithis].first, coeff);
-        ++iother;
-        ++ithis;
-      }
-      else {
-        eq.emplace_back(_eq[ithis].first, _eq[ithis].second);
-        ++ithis;
-      }
-    }
-
-    if (iother < other.size())
-      for(; iother < other.size(); ++iother)
-        eq.emplace_back(other[iother], -scale * other.coeff(iother));
-    if (ithis < _eq.size())
-      for (; ithis < _eq.size(); ++ithis)
-        eq.emplace_back(_eq[ithis]);
-
-    std::swap(eq, _eq);
+  // reduce by all the pivot rows in one pass and normalize
+  // lineNumber: line number in gauss of the pivot row of each weight
+  // gauss: normalized pivot rows
+  // the columns are visited from the largest weight in spa, a column with a
+  // pivot row is eliminated, the others are the result in descending order
+  void reduce(const std::vector<unsigned> &lineNumber,
+              const std::vector<EquationMod> &gauss,
+              SparseAccumulator<T> &spa) {
+    spa.reduce(_eq, lineNumber, [&gauss](unsigned line) {
+      return std::span<const std::pair<unsigned, T>>(gauss[line]._eq);
+    });
+    // the result is stored in a new vector of the exact size, allocated and
+    // first touched by the reducing thread
+    std::vector<std::pair<unsigned, T>>().swap(_eq);
+    unsigned size = spa.weights().size();
+    _eq.reserve(size);
+    for (unsigned i = 0; i < size; ++i)
+      _eq.emplace_back(spa.weights()[i], spa.coeffs()[i]);
   }
 
   // get the underline eq, only readable
@@ -108,7 +223,7 @@ public:
   }
 
   // order of equations
-  bool operator<(const EquationFF& other) const {
+  bool operator<(const EquationMod& other) const {
     if (this->first_integral() != other.first_integral())
       return this->first_integral() < other.first_integral();
     else {
@@ -120,13 +235,16 @@ public:
   }
 
 private:
-  std::vector<std::pair<unsigned, umod64>> _eq;
+  std::vector<std::pair<unsigned, T>> _eq;
 public:
   unsigned eqnum = 0;
 };
 
+// equation over the 63 bit finite field
+typedef EquationMod<umod64> EquationFF;
 
 // symbolic equation
+// coefficients are rational functions in D and the invariants
 class EquationSym {
 public:
   unsigned operator[](unsigned i) const {
@@ -137,13 +255,13 @@ public:
     return _eq[i].first;
   }
 
-  [[nodiscard]] GiNaC::ex coeff(unsigned i) const {
+  [[nodiscard]] const RationalFunction &coeff(unsigned i) const {
     return _eq[i].second;
   }
 
   // insert a new item
-  void insert(unsigned integral, GiNaC::ex& coeff) {
-    _eq.emplace_back(integral, coeff);
+  void insert(unsigned integral, RationalFunction &&coeff) {
+    _eq.emplace_back(integral, std::move(coeff));
   }
 
   // number of items
@@ -157,7 +275,7 @@ public:
   }
 
   // get the first coefficient
-  GiNaC::ex first_coeff() {
+  const RationalFunction &first_coeff() {
     return _eq[0].second;
   }
 
@@ -168,29 +286,29 @@ public:
 
   void sort() {
     std::sort(_eq.begin(), _eq.end(),
-              [](const std::pair<unsigned, GiNaC::ex>& i, const std::pair<unsigned, GiNaC::ex>& j){
+              [](const std::pair<unsigned, RationalFunction>& i, const std::pair<unsigned, RationalFunction>& j){
                 return i.first > j.first;
               });
   }
 
   // clear zero items
   void erase_zero() {
-    std::erase_if(_eq, [](const auto &item) { return item.second == 0; });
+    std::erase_if(_eq, [](const auto &item) { return item.second.is_zero(); });
   }
 
   // normalize: set the first coeff to one
   void normalize() {
-    GiNaC::ex scale = _eq[0].second;
+    RationalFunction scale = _eq[0].second.inverse();
     for (auto &item: _eq)
-      item.second /= scale;
+      item.second *= scale;
   }
 
   // gauss elimination: eliminate the other equation from this one
   // it is assumed that the other equation has been normalized
   void eliminate(const EquationSym &other, unsigned index) {
-    std::vector<std::pair<unsigned, GiNaC::ex>> eq;
+    std::vector<std::pair<unsigned, RationalFunction>> eq;
 
-    GiNaC::ex scale = _eq[index].second;
+    RationalFunction scale = _eq[index].second;
     unsigned iother = 0, ithis = 0;
     while (iother < other.size() && ithis < _eq.size()) {
       if(other[iother] > _eq[ithis].first) {
@@ -198,24 +316,24 @@ public:
         ++iother;
       }
       else if (other[iother] == _eq[ithis].first) {
-        GiNaC::ex coeff = (_eq[ithis].second - scale * other.coeff(iother)).expand();
-        if (coeff != 0)
-          eq.emplace_back(_eq[ithis].first, coeff);
+        RationalFunction coeff = _eq[ithis].second - scale * other._eq[iother].second;
+        if (!coeff.is_zero())
+          eq.emplace_back(_eq[ithis].first, std::move(coeff));
         ++iother;
         ++ithis;
       }
       else {
-        eq.emplace_back(_eq[ithis].first, _eq[ithis].second);
+        eq.emplace_back(_eq[ithis].first, std::move(_eq[ithis].second));
         ++ithis;
       }
     }
 
     if (iother < other.size())
       for(; iother < other.size(); ++iother)
-        eq.emplace_back(other[iother], -scale * other.coeff(iother));
+        eq.emplace_back(other[iother], -scale * other._eq[iother].second);
     if (ithis < _eq.size())
       for (; ithis < _eq.size(); ++ithis)
-        eq.emplace_back(_eq[ithis]);
+        eq.emplace_back(std::move(_eq[ithis]));
 
     std::swap(eq, _eq);
   }
@@ -243,7 +361,7 @@ public:
   }
 
 public:
-  std::vector<std::pair<unsigned, GiNaC::ex>> _eq;
+  std::vector<std::pair<unsigned, RationalFunction>> _eq;
 public:
   unsigned eqnum = 0;
 };
\ No newline at end of file
@@ -1,9 +1,28 @@
 #include "family.h"
-#include "BS_thread_pool.hpp"
+#include "convert.h"
+#include "log.h"
+#include "sample.h"
+#include "stats.h"
+#include "tasks.h"
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <optional>
+#include <thread>
+
+#include <unistd.h>
 
 GiNaC::symtab Family::symtab;
 
+// magic number and version of the family cache
+static const char CACHE_MAGIC[8] = {'I', 'N', 'I', 'B', 'P', 'F', 'C', '\0'};
+static const uint32_t CACHE_VERSION = 1;
+
 Family::Family(const YAML::Node &config) {
+  ScopedTimer timer("parse");
   if (!config["family"])
     throw std::runtime_error("family not found");
   YAML::Node familyConfig = config["family"];
@@ -107,31 +126,52 @@ Family::Family(const YAML::Node &config) {
             .subs(_one)
             .expand());
 
-  std::cout << "\n \033[1m\033[32m#0.0\033[0m   Parsing config file finished."
-            << std::endl;
+  LOG_INFO("\n \033[1m\033[32m#0.0\033[0m   Parsing config file finished.");
 
   _symIndices = generate_symbols("a", _nprops);
   _symProps = generate_symbols("D", _nprops);
+
+  // the cache and checkpoints are keyed by the family config
+  _hash = fnv1a(YAML::Dump(familyConfig));
+  if (config["cache"] && !config["cache"].IsNull())
+    _cacheDir = config["cache"].as<std::string>();
 }
 
 void Family::init() {
-  std::cout << "\n \033[33m#0.1\033[0m   Initializing integral family...\n";
-  _compute_sps();
-  _compute_symanzik();
-  std::cout << "\n \033[1m\033[32m#0.1\033[0m   Initializing integral family "
-               "finished.\n";
-
-  std::cout << "\n \033[33m#0.2\033[0m   Generating IBP relations...\n";
-  _generate_ibp();
-  std::cout
-      << "\n \033[1m\033[32m#0.2\033[0m   Generating IBP relations finished.\n";
+  if (_load_cache()) {
+    LOG_INFO("\n \033[1m\033[32m#0.1\033[0m   Loading cached family "
+             "finished.");
+    return;
+  }
+
+  LOG_INFO("\n \033[33m#0.1\033[0m   Initializing integral family...");
+  {
+    ScopedTimer timer("sps");
+    _compute_sps();
+  }
+  {
+    ScopedTimer timer("symanzik");
+    _compute_symanzik();
+  }
+  LOG_INFO("\n \033[1m\033[32m#0.1\033[0m   Initializing integral family "
+           "finished.");
+
+  LOG_INFO("\n \033[33m#0.2\033[0m   Generating IBP relations...");
+  {
+    ScopedTimer timer("ibp");
+    _generate_ibp();
+  }
+  LOG_INFO(
+      "\n \033[1m\033[32m#0.2\033[0m   Generating IBP relations finished.");
+
+  _save_cache();
 }
 
-void Family::init_reduce(const YAML::Node &config, Reduce &reduce) const {
+void Family::init_reduce(const YAML::Node &config, Reduce &reduce) {
   reduce._symbols = _symbols;
   reduce._symIndices = _symIndices;
 
-  std::cout << "\n \033[33m#0.3\033[0m   Collecting target integrals...\n";
+  LOG_INFO("\n \033[33m#0.3\033[0m   Collecting target integrals...");
   if (!config["targets"])
     throw std::runtime_error("reduce targets not found");
   reduce._rawTargets = config["targets"].as<std::vector<RawIntegral>>();
@@ -155,52 +195,393 @@ void Family::init_reduce(const YAML::Node &config, Reduce &reduce) const {
   for (unsigned i = 0; i < _nprops; ++i)
     if (hasLine[i])
       reduce._top |= 1 << i;
-  std::cout << "\n \033[1m\033[32m#0.3\033[0m   Collecting target integrals "
-               "finished.\n";
+  LOG_INFO("\n \033[1m\033[32m#0.3\033[0m   Collecting target integrals "
+           "finished.");
+
+  LOG_INFO("\n \033[33m#0.4\033[0m   Searching trivial sectors...");
+  if (_trivialTop != 0 && (reduce._top & _trivialTop) == reduce._top) {
+    // sectors under a searched top sector are known
+    reduce._sectors = std::vector<bool>(reduce._top + 1, false);
+    for (unsigned sector = 0; sector <= reduce._top; ++sector)
+      reduce._sectors[sector] =
+          (sector & reduce._top) == sector && _nonTrivial[sector];
+  } else {
+    ScopedTimer timer("trivial_sectors");
+    _search_trivial_sectors(reduce);
+    _trivialTop = reduce._top;
+    _nonTrivial = reduce._sectors;
+    _save_cache();
+  }
+  LOG_INFO("\n \033[1m\033[32m#0.4\033[0m   Searching trivial sectors "
+           "finished.");
+
+  // the finite field of the reduction
+  uint64_t modulus = umod64::modulus();
+  if (config["field"] && !config["field"].IsNull()) {
+    reduce._field = config["field"].as<unsigned>();
+    if (reduce._field == 50)
+      modulus = umod50::modulus();
+    else if (reduce._field == 31)
+      modulus = umod31::modulus();
+    else if (reduce._field != 63)
+      throw std::runtime_error("field must be 63, 50 or 31");
+  }
+
+  // distributed reduction over processes
+  if (config["cluster"] && !config["cluster"].IsNull()) {
+    YAML::Node clusterConfig = config["cluster"];
+    if (clusterConfig["serve"] && clusterConfig["worker"])
+      throw std::runtime_error("cluster must either serve or work");
+    if (clusterConfig["serve"])
+      reduce._serve = clusterConfig["serve"].as<std::string>();
+    if (clusterConfig["worker"]) {
+      // the coordinator decides the finite field values and keeps the
+      // checkpoints
+      reduce._coordinator = std::make_unique<Connection>(
+          Connection::connect(clusterConfig["worker"].as<std::string>()));
+      std::vector<umod64> values =
+          join_coordinator(*reduce._coordinator, _hash, modulus);
+      if (values != _ffValues) {
+        _ffValues = std::move(values);
+        _ibpFF.clear();
+        _generate_ibp_ff();
+      }
+    }
+  }
+
+  // checkpoints, only kept by the coordinator of a cluster
+  if (config["checkpoint"] && !config["checkpoint"].IsNull() &&
+      !reduce._coordinator) {
+    YAML::Node ckptConfig = config["checkpoint"];
+    if (!ckptConfig["path"])
+      throw std::runtime_error("checkpoint path not found");
+    reduce._checkpoint = Checkpoint(
+        ckptConfig["path"].as<std::string>(),
+        ckptConfig["interval"] ? ckptConfig["interval"].as<unsigned>() : 600,
+        ckptConfig["resume"] && ckptConfig["resume"].as<bool>());
+
+    if (reduce._checkpoint.resume()) {
+      // the finite field values must match the checkpoints
+      std::vector<umod64> values;
+      if (!reduce._checkpoint.load_state(_hash, modulus, values))
+        throw std::runtime_error("no checkpoint to resume from");
+      if (values != _ffValues) {
+        _ffValues = std::move(values);
+        _ibpFF.clear();
+        _generate_ibp_ff();
+      }
+    } else {
+      reduce._checkpoint.reset();
+      reduce._checkpoint.save_state(_hash, modulus, _ffValues);
+    }
+  }
+
+  // sample points of a sector for the reconstruction
+  if (config["sample"] && !config["sample"].IsNull()) {
+    YAML::Node sampleConfig = config["sample"];
+    if (!sampleConfig["points"])
+      throw std::runtime_error("sample points not found");
+    reduce._samples = sampleConfig["points"].as<uint64_t>();
+    reduce._sampleSector = sampleConfig["sector"]
+                               ? sampleConfig["sector"].as<unsigned>()
+                               : reduce._top;
+    if (sampleConfig["first"])
+      reduce._sampleFirst = sampleConfig["first"].as<uint64_t>();
+    if (sampleConfig["seed"])
+      reduce._sampleSeed = sampleConfig["seed"].as<uint64_t>();
+  }
+
+  // seconds between progress reports
+  if (config["progress"] && !config["progress"].IsNull())
+    reduce._progress.set_interval(config["progress"].as<double>());
+
+  // memory budget of the sector systems
+  if (config["memory"] && !config["memory"].IsNull()) {
+    YAML::Node memConfig = config["memory"];
+    if (!memConfig["budget"])
+      throw std::runtime_error("memory budget not found");
+    reduce._memoryBudget = memConfig["budget"].as<uint64_t>() << 20;
+    reduce._spillPath =
+        memConfig["path"] ? memConfig["path"].as<std::string>()
+                          : std::filesystem::temp_directory_path().string();
+  }
+
+  // directory of the reduction tables
+  if (config["tables"] && !config["tables"].IsNull()) {
+    reduce._tablePath = config["tables"].as<std::string>();
+    if (!reduce._tablePath.empty())
+      std::filesystem::create_directories(reduce._tablePath);
+    else if (reduce._checkpoint.enabled() || !reduce._serve.empty() ||
+             reduce._coordinator)
+      throw std::runtime_error("checkpoints and clusters need the tables");
+  }
 
-  std::cout << "\n \033[33m#0.4\033[0m   Searching trivial sectors...\n";
-  _search_trivial_sectors(reduce);
-  std::cout << "\n \033[1m\033[32m#0.4\033[0m   Searching trivial sectors "
-               "finished.\n";
+  // worker threads of the sector reductions
+  if (config["threads"] && !config["threads"].IsNull())
+    reduce._threads = std::max(1u, config["threads"].as<unsigned>());
+
+  // bind the workers to the NUMA nodes
+  if (config["numa"] && !config["numa"].IsNull())
+    reduce._numa = config["numa"].as<bool>();
+
+  // generated sector systems waiting for the elimination
+  if (config["pipeline"] && !config["pipeline"].IsNull())
+    reduce._pipeline = config["pipeline"].as<unsigned>();
 
   reduce.prepare_sectors();
 }
 
+// print the master integrals of a reduction table
+static void print_masters(const ReductionTable &table, unsigned sector) {
+  for (unsigned key : table.masters()) {
+    auto indices = table.key(key);
+    LOG_INFO("      "
+             << RawIntegral(std::vector<int>(indices.begin(), indices.end()))
+             << "  # " << sector);
+  }
+}
+
 void Family::run_reduce(Reduce &reduce) const {
-  BS::thread_pool pool(1);
+  if (reduce._samples != 0) {
+    if (reduce._field == 50)
+      _run_samples<umod50>(reduce);
+    else if (reduce._field == 31)
+      _run_samples<umod31>(reduce);
+    else
+      _run_samples<umod64>(reduce);
+    return;
+  }
+  if (!reduce._serve.empty()) {
+    _serve_reduce(reduce);
+    return;
+  }
+  switch (reduce._field) {
+  case 50:
+    _run_reduce(reduce, _evaluate_ibp<umod50>());
+    break;
+  case 31:
+    _run_reduce(reduce, _evaluate_ibp<umod31>());
+    break;
+  default:
+    _run_reduce(reduce, _ibpFF);
+  }
+}
+
+template <typename T>
+void Family::_run_reduce(Reduce &reduce,
+                         const std::vector<IBPProtoMod<T>> &ibps) const {
+  if (reduce._coordinator) {
+    _work_reduce(reduce, ibps);
+    return;
+  }
+  // one more worker for the pipeline, it generates while the others
+  // eliminate; with numa each node generates
+  TaskScheduler scheduler(reduce._threads + (reduce._pipeline != 0),
+                          reduce._numa);
+  TaskGroup group(scheduler);
 
+  reduce._progress.start(reduce._reduceSectors.size(), scheduler.size());
+  // sectors left for the pipeline
+  std::vector<const Sector *> pending;
   for (auto &sector : reduce._reduceSectors) {
-    // if (sector.id() == 2887)
-    pool.push_task(&Sector::run_reduce_ff, sector, _ibp);
+    // sectors completed in a previous run
+    if (reduce._checkpoint.completed(sector.id())) {
+      reduce._progress.sector_end(sector.id());
+      print_masters(ReductionTable(reduce._checkpoint.table_path(sector.id())),
+                    sector.id());
+      continue;
+    }
+    if (reduce._pipeline == 0)
+      group.submit([sector, &ibps]() mutable { sector.run_reduce(ibps); });
+    else
+      pending.push_back(&sector);
+  }
+
+  // pipeline: the systems of the next sectors are generated one after the
+  // other while the workers eliminate the generated ones
+  // the eliminations go first, and a sector is generated once the
+  // elimination reduce._pipeline sectors before it has finished, so at most
+  // that many generated systems wait
+  // numa: each node generates its share of the sectors and eliminates them,
+  // a system stays on the node that first touched it
+  if (!pending.empty()) {
+    std::vector<std::optional<std::pair<Sector, SectorSystem<T>>>> jobs(
+        pending.size());
+    TaskGraph graph;
+    std::vector<unsigned> generate, eliminate;
+    size_t nodes = scheduler.nodes();
+    for (size_t i = 0; i < pending.size(); ++i) {
+      int node = i % nodes;
+      generate.push_back(graph.add(
+          [&, i] {
+            Sector job = *pending[i];
+            SectorSystem<T> system = job.run_generate(ibps);
+            jobs[i].emplace(std::move(job), std::move(system));
+          },
+          TaskPriority::Normal, node));
+      eliminate.push_back(graph.add(
+          [&, i] {
+            auto job = std::move(*jobs[i]);
+            jobs[i].reset();
+            job.first.run_eliminate(std::move(job.second));
+          },
+          TaskPriority::High, node));
+      graph.precede(generate[i], eliminate[i]);
+      if (i >= nodes)
+        graph.precede(generate[i - nodes], generate[i]);
+      if (i >= nodes * reduce._pipeline)
+        graph.precede(eliminate[i - nodes * reduce._pipeline], generate[i]);
+    }
+    graph.run(scheduler);
+  }
+  group.wait();
+}
+
+void Family::_serve_reduce(Reduce &reduce) const {
+  uint64_t modulus = reduce._field == 50   ? umod50::modulus()
+                     : reduce._field == 31 ? umod31::modulus()
+                                           : umod64::modulus();
+  Coordinator coordinator(reduce._serve, _hash, modulus, _ffValues);
+
+  reduce._progress.start(reduce._reduceSectors.size());
+  std::vector<unsigned> jobs;
+  for (const auto &sector : reduce._reduceSectors) {
+    if (reduce._checkpoint.completed(sector.id())) {
+      reduce._progress.sector_end(sector.id());
+      print_masters(ReductionTable(reduce._checkpoint.table_path(sector.id())),
+                    sector.id());
+    } else
+      jobs.push_back(sector.id());
+  }
+
+  // keep the table where a local reduction writes it, an invalid table
+  // throws and the job is reassigned
+  coordinator.run(jobs, [&](unsigned sector, const std::string &bytes) {
+    std::string path = table_file(reduce._tablePath, sector);
+    {
+      std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+      file.write(bytes.data(), (std::streamsize)bytes.size());
+      if (!file)
+        throw std::runtime_error("cannot write " + path);
+    }
+    {
+      ReductionTable table(path + ".tmp");
+      if (table.sector() != sector)
+        throw std::runtime_error("table of another sector");
+      if (table.rational() || table.modulus() != modulus)
+        throw std::runtime_error("table of another field");
+    }
+    std::filesystem::rename(path + ".tmp", path);
+    ReductionTable table(path);
+    if (reduce._checkpoint.enabled())
+      reduce._checkpoint.complete(sector, path);
+    reduce._progress.sector_end(sector);
+    print_masters(table, sector);
+  });
+}
+
+template <typename T>
+void Family::_work_reduce(Reduce &reduce,
+                          const std::vector<IBPProtoMod<T>> &ibps) const {
+  Connection &coordinator = *reduce._coordinator;
+  Message type;
+  std::string payload;
+  while (coordinator.receive(type, payload) && type == Message::Job) {
+    auto id = PayloadReader(payload).get<uint32_t>();
+    PayloadWriter reply;
+    reply.put(id);
+    try {
+      auto it = std::find_if(
+          reduce._reduceSectors.begin(), reduce._reduceSectors.end(),
+          [id](const Sector &sector) { return sector.id() == id; });
+      if (it == reduce._reduceSectors.end())
+        throw std::runtime_error("sector " + std::to_string(id) +
+                                 " is not a reduction job");
+      Sector job = *it;
+      job.run_reduce(ibps);
+
+      std::ifstream file(table_file(reduce._tablePath, id), std::ios::binary);
+      if (!file)
+        throw std::runtime_error("cannot read the table of sector " +
+                                 std::to_string(id));
+      reply.put_string(std::string(std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>()));
+      coordinator.send(Message::Result, reply.data());
+    } catch (std::exception &e) {
+      LOG_ERROR("sector " << id << " failed: " << e.what());
+      reply.put_string(e.what());
+      coordinator.send(Message::Failed, reply.data());
+    }
   }
-  pool.wait_for_tasks();
-  // pool.push_task(&Sector::run_reduce, sector, _ibpFF);
+}
+
+template <typename T> void Family::_run_samples(Reduce &reduce) const {
+  auto sector = std::find_if(
+      reduce._reduceSectors.begin(), reduce._reduceSectors.end(),
+      [&](const Sector &job) { return job.id() == reduce._sampleSector; });
+  if (sector == reduce._reduceSectors.end())
+    throw std::runtime_error("sector " + std::to_string(reduce._sampleSector) +
+                             " is not a reduction job");
+
+  // the system and the masters are learned at the finite field values
+  std::vector<T> probe;
+  for (const auto &value : _ffValues)
+    probe.push_back(T::reduce(value.value()));
+  std::optional<ScopedTimer> timer;
+  timer.emplace("learn", sector->id());
+  LearnedSector<T> learned(*sector, ibp_sym(), probe);
+  timer.reset();
+  LOG_INFO("\n  Sector " << learned.id() << ": " << learned.size()
+                         << " equations, " << learned.masters().size()
+                         << " masters");
+
+  TaskScheduler scheduler(reduce._threads, reduce._numa);
+  SampleFarm<T> farm(learned, scheduler);
+  SampleWriter<T> writer("samples_" + std::to_string(learned.id()) + ".bin",
+                         learned, probe.size());
+  uint64_t unlucky = 0;
+  timer.emplace("sample", sector->id());
+  // points first, ..., first + samples - 1 of the stream, processes with
+  // disjoint ranges sample disjoint points
+  double rate = farm.run(
+      reduce._sampleFirst, reduce._samples,
+      [&](uint64_t index) {
+        return sample_point<T>(reduce._sampleSeed, index, probe.size());
+      },
+      [&](Sample<T> &&sample) {
+        unlucky += sample.unlucky;
+        writer.write(sample);
+      },
+      2 * scheduler.size());
+  timer.reset();
+  LOG_INFO("  " << reduce._samples << " samples, " << unlucky
+                << " unlucky, " << std::fixed << std::setprecision(1) << rate
+                << " samples/s");
 }
 
 void Family::print() const {
-  std::cout
-      << "\n----------------- \033[36mFamily Info\033[0m ------------------\n"
+  std::ostringstream out;
+  out << "\n----------------- \033[36mFamily Info\033[0m ------------------\n"
       << "\n  Topology: " << _name << "   Dimension: " << _dimension
       << "\n\n  Internals:";
   for (const auto &sym : _internals)
-    std::cout << " " << sym;
+    out << " " << sym;
 
-  std::cout << "\n\n  Externals:";
+  out << "\n\n  Externals:";
   for (const auto &sym : _externals)
-    std::cout << " " << sym;
+    out << " " << sym;
 
-  std::cout << "\n\n  Invariants:";
+  out << "\n\n  Invariants:";
   for (const auto &inv : _invariants)
-    std::cout << " " << inv.first;
+    out << " " << inv.first;
 
-  std::cout << "\n\n  Propagators: " << _nprops
-            << "   IBP relations: " << _ibp.size();
+  out << "\n\n  Propagators: " << _nprops << "   IBP relations: " << _ibp.size();
 
-  std::cout << std::endl;
+  LOG_INFO(out.str());
 }
 
 void Family::_generate_ibp() {
-  GiNaC::ex coeff, coeffD;
+  GiNaC::ex coeff;
   std::map<RawIntegral, GiNaC::ex> equation;
 
   // i: l_i in derivatives
@@ -227,21 +608,7 @@ void Family::_generate_ibp() {
           integral[s] = 1;
           // substitute scalar products by propagators
           coeff = coeff.subs(_spsFromProps, GiNaC::subs_options::algebraic);
-          // t: D_t in coeff
-          for (size_t t = 0; t < _nprops; ++t) {
-            coeffD = coeff.diff(_symProps[t]);
-            if (coeffD != 0) {
-              integral[t] -= 1;
-              equation[integral] += coeffD;
-              integral[t] += 1;
-            }
-            coeff = coeff.subs(_symProps[t] == 0);
-            if (coeff == 0)
-              break;
-          }
-          coeff = coeff.expand();
-          if (coeff != 0)
-            equation[integral] += coeff;
+          _collect_props(coeff, integral, equation);
         }
       }
       // add to _ibp
@@ -256,11 +623,12 @@ void Family::_generate_ibp() {
     }
   }
   _generate_li();
+  _generate_ibp_poly();
   _generate_ibp_ff();
 }
 
 void Family::_generate_li() {
-  GiNaC::ex coeff1, coeff2, coeff, coeffD;
+  GiNaC::ex coeff1, coeff2, coeff;
   std::map<RawIntegral, GiNaC::ex> equation;
 
   // (u, v): E(E-1)/2 equations
@@ -286,21 +654,7 @@ void Family::_generate_li() {
             coeff = (coeff1 * coeff2)
                         .expand()
                         .subs(_spsFromProps, GiNaC::subs_options::algebraic);
-            // t: D_t in coeff
-            for (size_t t = 0; t < _nprops; ++t) {
-              coeffD = coeff.diff(_symProps[t]);
-              if (coeffD != 0) {
-                integral[t] -= 1;
-                equation[integral] += coeffD;
-                integral[t] += 1;
-              }
-              coeff = coeff.subs(_symProps[t] == 0);
-              if (coeff == 0)
-                break;
-            }
-            coeff = coeff.expand();
-            if (coeff != 0)
-              equation[integral] += coeff;
+            _collect_props(coeff, integral, equation);
           }
 
           coeff1 = (-2 * _propagators[p].diff(_externals[i]) *
@@ -318,21 +672,7 @@ void Family::_generate_li() {
             coeff = (coeff1 * coeff2)
                         .expand()
                         .subs(_spsFromProps, GiNaC::subs_options::algebraic);
-            // t: D_t in coeff
-            for (size_t t = 0; t < _nprops; ++t) {
-              coeffD = coeff.diff(_symProps[t]);
-              if (coeffD != 0) {
-                integral[t] -= 1;
-                equation[integral] += coeffD;
-                integral[t] += 1;
-              }
-              coeff = coeff.subs(_symProps[t] == 0);
-              if (coeff == 0)
-                break;
-            }
-            coeff = coeff.expand();
-            if (coeff != 0)
-              equation[integral] += coeff;
+            _collect_props(coeff, integral, equation);
           }
         }
       }
@@ -349,42 +689,87 @@ void Family::_generate_li() {
   }
 }
 
-void Family::_generate_ibp_ff() {
-  // choose random primes for symbols
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<unsigned> dis(0, 15);
-  std::set<unsigned> used;
-  while (used.size() < _symbols.size()) {
-    unsigned prime = dis(gen);
-    used.insert(prime);
-  }
-
-  GiNaC::lst values;
-  auto it = used.cbegin();
-  for (unsigned i = 0; i < _symbols.size(); ++i, ++it)
-    values.append(_symbols[i] == PRIMES64[*it]);
-
-  // convert to numeric equations
+void Family::_collect_props(const GiNaC::ex &coeff, RawIntegral integral,
+                            std::map<RawIntegral, GiNaC::ex> &equation) const {
+  // coeff is linear in D_t, each D_t lowers the index t by one
+  std::vector<GiNaC::ex> coeffs = linear_coeffs(coeff.expand(), _symProps);
+  for (size_t t = 0; t < _nprops; ++t) {
+    if (coeffs[t] != 0) {
+      integral[t] -= 1;
+      equation[integral] += coeffs[t];
+      integral[t] += 1;
+    }
+  }
+  if (coeffs[_nprops] != 0)
+    equation[integral] += coeffs[_nprops];
+}
+
+void Family::_generate_ibp_poly() {
+  // variables: a1, ..., an, symbols
+  std::vector<GiNaC::ex> vars(_symIndices.begin(), _symIndices.end());
+  vars.insert(vars.end(), _symbols.begin(), _symbols.end());
+
   for (const auto &ibp : _ibp) {
-    IBPProtoFF ibpFF;
+    IBPProtoPoly ibpPoly;
+    for (const auto &term : ibp)
+      ibpPoly.emplace_back(term.first, to_poly(term.second, vars));
+    _ibpPoly.emplace_back(std::move(ibpPoly));
+  }
+}
+
+void Family::_generate_ibp_ff() {
+  if (_ffValues.size() != _symbols.size()) {
+    // choose random primes for symbols
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<unsigned> dis(0, 15);
+    std::set<unsigned> used;
+    while (used.size() < _symbols.size()) {
+      unsigned prime = dis(gen);
+      used.insert(prime);
+    }
+
+    _ffValues.clear();
+    auto it = used.cbegin();
+    for (unsigned i = 0; i < _symbols.size(); ++i, ++it)
+      _ffValues.emplace_back(PRIMES64[*it]);
+  }
+
+  _ibpFF = _evaluate_ibp<umod64>();
+}
+
+std::vector<IBPProtoSym> Family::ibp_sym() const {
+  // split the polynomial prototypes into coefficients of a1, ..., an
+  std::vector<IBPProtoSym> ibps;
+  for (const auto &ibp : _ibpPoly) {
+    IBPProtoSym ibpSym;
+    for (const auto &term : ibp)
+      ibpSym.emplace_back(term.first, term.second.linear_coeffs_in(_nprops));
+    ibps.emplace_back(std::move(ibpSym));
+  }
+  return ibps;
+}
+
+template <typename T>
+std::vector<IBPProtoMod<T>> Family::_evaluate_ibp() const {
+  // the symbol values are reduced to the field
+  std::vector<T> values;
+  for (const auto &value : _ffValues)
+    values.push_back(T::reduce(value.value()));
+
+  // evaluate the polynomial prototypes at the symbol values
+  std::vector<IBPProtoMod<T>> ibps;
+  for (const auto &ibp : _ibpPoly) {
+    IBPProtoMod<T> ibpMod;
     for (const auto &term : ibp) {
-      GiNaC::ex item = term.second.subs(values).expand();
-      std::vector<umod64> coeffs;
-      for (unsigned i = 0; i < _nprops; ++i) {
-        std::stringstream ss;
-        ss << item.coeff(_symIndices[i]);
-        coeffs.push_back(umod64::from(ss.str()));
-        item -= item.coeff(_symIndices[i]) * _symIndices[i];
-      }
-      // constant term
-      std::stringstream ss;
-      ss << item;
-      coeffs.push_back(umod64::from(ss.str()));
-      ibpFF.emplace_back(term.first, std::move(coeffs));
+      SparsePoly<T> coeff = term.second.transform<T>(
+          [](const Rational &num) { return num.to_mod<T>(); });
+      ibpMod.emplace_back(
+          term.first, coeff.evaluate_from(_nprops, values).linear_coeffs());
     }
-    _ibpFF.emplace_back(std::move(ibpFF));
+    ibps.emplace_back(std::move(ibpMod));
   }
+  return ibps;
 }
 
 void Family::_search_trivial_sectors(Reduce &reduce) const {
@@ -542,6 +927,166 @@ void Family::_compute_symanzik() {
                .expand();
 }
 
+std::string Family::_cache_file() const {
+  std::stringstream ss;
+  ss << _name << "_" << std::hex << std::setw(16) << std::setfill('0') << _hash
+     << ".cache";
+  return (std::filesystem::path(_cacheDir) / ss.str()).string();
+}
+
+bool Family::_load_cache() {
+  if (_cacheDir.empty())
+    return false;
+  std::ifstream file(_cache_file(), std::ios::binary);
+  if (!file)
+    return false;
+
+  // header
+  char magic[8];
+  file.read(magic, sizeof(magic));
+  if (!file || !std::equal(magic, magic + 8, CACHE_MAGIC) ||
+      read_binary<uint32_t>(file) != CACHE_VERSION ||
+      read_binary<uint64_t>(file) != _hash ||
+      read_binary<uint32_t>(file) != _nprops)
+    return false;
+
+  // a truncated or corrupt cache is a miss, the family is regenerated
+  std::vector<std::vector<RawIntegral>> integrals;
+  unsigned trivialTop;
+  std::vector<bool> nonTrivial;
+  GiNaC::ex spsRules, spsFromProps, uPoly, fPoly, coeffs;
+  try {
+    // integrals of the ibp relations
+    integrals.resize(read_binary<uint32_t>(file));
+    for (auto &ibp : integrals) {
+      ibp.resize(read_binary<uint32_t>(file), RawIntegral(_nprops));
+      for (auto &integral : ibp)
+        for (unsigned i = 0; i < _nprops; ++i)
+          integral[i] = read_binary<int32_t>(file);
+    }
+
+    // trivial sectors
+    trivialTop = read_binary<uint32_t>(file);
+    nonTrivial.resize(read_binary<uint32_t>(file));
+    for (unsigned i = 0; i < nonTrivial.size(); i += 8) {
+      auto byte = read_binary<uint8_t>(file);
+      for (unsigned j = 0; j < 8 && i + j < nonTrivial.size(); ++j)
+        nonTrivial[i + j] = byte & (1 << j);
+    }
+
+    // expressions
+    GiNaC::archive ar;
+    file >> ar;
+    if (!file)
+      return false;
+
+    GiNaC::lst syms;
+    for (const auto &sym : _symbols)
+      syms.append(sym);
+    for (const auto &inv : _invariants)
+      syms.append(inv.first);
+    for (const auto &sym : _internals)
+      syms.append(sym);
+    for (const auto &sym : _externals)
+      syms.append(sym);
+    for (const auto &sym : _symIndices)
+      syms.append(sym);
+    for (const auto &sym : _symProps)
+      syms.append(sym);
+
+    spsRules = ar.unarchive_ex(syms, "sps_rules");
+    spsFromProps = ar.unarchive_ex(syms, "sps_props");
+    uPoly = ar.unarchive_ex(syms, "U");
+    fPoly = ar.unarchive_ex(syms, "F");
+    coeffs = ar.unarchive_ex(syms, "ibp");
+  } catch (std::exception &e) {
+    LOG_WARNING("ignoring corrupt cache " << _cache_file() << ": "
+                                         << e.what());
+    return false;
+  }
+  size_t nterms = 0;
+  for (const auto &ibpIntegrals : integrals)
+    nterms += ibpIntegrals.size();
+  if (!is_a<GiNaC::lst>(spsRules) || !is_a<GiNaC::lst>(spsFromProps) ||
+      coeffs.nops() != nterms) {
+    LOG_WARNING("ignoring corrupt cache " << _cache_file());
+    return false;
+  }
+
+  _spsRules = GiNaC::ex_to<GiNaC::lst>(spsRules);
+  _spsFromProps = GiNaC::ex_to<GiNaC::lst>(spsFromProps);
+  _uPoly = uPoly;
+  _fPoly = fPoly;
+  size_t index = 0;
+  for (const auto &ibpIntegrals : integrals) {
+    IBPProto ibp;
+    for (const auto &integral : ibpIntegrals)
+      ibp.emplace_back(integral, coeffs.op(index++));
+    _ibp.push_back(std::move(ibp));
+  }
+  _trivialTop = trivialTop;
+  _nonTrivial = std::move(nonTrivial);
+
+  _generate_ibp_poly();
+  _generate_ibp_ff();
+  return true;
+}
+
+void Family::_save_cache() const {
+  if (_cacheDir.empty())
+    return;
+  std::filesystem::create_directories(_cacheDir);
+  // written through a temporary file and renamed, so an interrupted write
+  // leaves no partial cache, the pid keeps processes sharing the cache apart
+  std::string tmp = _cache_file() + ".tmp" + std::to_string(getpid());
+  std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("cannot write cache file " + tmp);
+
+  // header
+  file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  write_binary(file, CACHE_VERSION);
+  write_binary(file, _hash);
+  write_binary<uint32_t>(file, _nprops);
+
+  // integrals of the ibp relations
+  write_binary<uint32_t>(file, _ibp.size());
+  for (const auto &ibp : _ibp) {
+    write_binary<uint32_t>(file, ibp.size());
+    for (const auto &term : ibp)
+      for (unsigned i = 0; i < _nprops; ++i)
+        write_binary<int32_t>(file, term.first[i]);
+  }
+
+  // trivial sectors
+  write_binary<uint32_t>(file, _trivialTop);
+  write_binary<uint32_t>(file, _nonTrivial.size());
+  for (unsigned i = 0; i < _nonTrivial.size(); i += 8) {
+    uint8_t byte = 0;
+    for (unsigned j = 0; j < 8 && i + j < _nonTrivial.size(); ++j)
+      if (_nonTrivial[i + j])
+        byte |= 1 << j;
+    write_binary(file, byte);
+  }
+
+  // expressions
+  GiNaC::archive ar;
+  ar.archive_ex(_spsRules, "sps_rules");
+  ar.archive_ex(_spsFromProps, "sps_props");
+  ar.archive_ex(_uPoly, "U");
+  ar.archive_ex(_fPoly, "F");
+  GiNaC::lst coeffs;
+  for (const auto &ibp : _ibp)
+    for (const auto &term : ibp)
+      coeffs.append(term.second);
+  ar.archive_ex(coeffs, "ibp");
+  file << ar;
+  file.close();
+  if (!file)
+    throw std::runtime_error("cannot write cache file " + tmp);
+  std::filesystem::rename(tmp, _cache_file());
+}
+
 std::vector<GiNaC::symbol> Family::generate_symbols(const std::string &name,
                                                     unsigned n) {
   std::vector<GiNaC::symbol> symbols(n);
@@ -551,15 +1096,12 @@ std::vector<GiNaC::symbol> Family::generate_symbols(const std::string &name,
 }
 
 void Reduce::print() const {
-  std::cout
-      << "\n----------------- \033[36mReduce Info\033[0m ------------------\n"
-      << "\n  Targets: " << _rawTargets.size() << "   Top sector: " << _top;
-
-  std::cout << "\n\n  Non-trivial sectors: "
-            << std::count_if(_sectors.begin(), _sectors.end(),
-                             [](bool value) { return value; });
-
-  std::cout << "\n" << std::endl;
+  LOG_INFO("\n----------------- \033[36mReduce Info\033[0m ------------------\n"
+           << "\n  Targets: " << _rawTargets.size() << "   Top sector: " << _top
+           << "\n\n  Non-trivial sectors: "
+           << std::count_if(_sectors.begin(), _sectors.end(),
+                            [](bool value) { return value; })
+           << "\n");
 }
 
 void Reduce::prepare_sectors() {
@@ -618,6 +1160,13 @@ void Reduce::prepare_sectors() {
     _reduceSectors[i]._rank = rank;
     _reduceSectors[i]._symbols = _symbols;
     _reduceSectors[i]._symIndices = _symIndices;
+    if (_checkpoint.enabled())
+      _reduceSectors[i]._checkpoint = &_checkpoint;
+    if (_progress.enabled())
+      _reduceSectors[i]._progress = &_progress;
+    _reduceSectors[i]._memoryBudget = _memoryBudget;
+    _reduceSectors[i]._spillPath = _spillPath;
+    _reduceSectors[i]._tablePath = _tablePath;
     for (unsigned j = 0; j < _nprops; ++j) {
       if (sectors[i] & (1 << j))
         _reduceSectors[i]._lines[j] = true;
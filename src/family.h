@@ -10,6 +10,9 @@
 
 #include "utils.h"
 #include "sector.h"
+#include "checkpoint.h"
+#include "cluster.h"
+#include "progress.h"
 
 
 class Family {
@@ -19,13 +22,18 @@ public:
   // initialize the family
   void init();
   // prepare reduce information
-  void init_reduce(const YAML::Node &, Reduce &) const;
+  void init_reduce(const YAML::Node &, Reduce &);
   // print family information
   void print() const;
 
   // run the reduction
   void run_reduce(Reduce &) const;
 
+  // ibp relations over finite field
+  const std::vector<IBPProtoFF> &ibp_ff() const { return _ibpFF; }
+  // ibp relations split for the symbolic reduction
+  std::vector<IBPProtoSym> ibp_sym() const;
+
   static std::vector<GiNaC::symbol> generate_symbols(const std::string &, unsigned);
 
 private:
@@ -38,11 +46,36 @@ private:
   void _generate_ibp();
   // generate li relations
   void _generate_li();
+  // add coeff * integral to the equation, resolving the propagators D_t
+  void _collect_props(const GiNaC::ex &, RawIntegral,
+                      std::map<RawIntegral, GiNaC::ex> &) const;
+  // convert ibp relations to sparse polynomials
+  void _generate_ibp_poly();
   // generate ibp over finite filed
   void _generate_ibp_ff();
+  // evaluate the polynomial ibp relations at _ffValues over the field of T
+  template <typename T>
+  std::vector<IBPProtoMod<T>> _evaluate_ibp() const;
+  // run the reduction jobs over the field of T
+  template <typename T>
+  void _run_reduce(Reduce &, const std::vector<IBPProtoMod<T>> &) const;
+  // coordinate the reduction jobs run by the worker processes
+  void _serve_reduce(Reduce &) const;
+  // run the reduction jobs of the coordinator over the field of T
+  template <typename T>
+  void _work_reduce(Reduce &, const std::vector<IBPProtoMod<T>> &) const;
+  // evaluate a learned sector at the sample points over the field of T
+  template <typename T> void _run_samples(Reduce &) const;
   // search trivial sectors
   void _search_trivial_sectors(Reduce &) const;
 
+  // path of the cache file
+  std::string _cache_file() const;
+  // load the initialized family from the cache
+  bool _load_cache();
+  // save the initialized family to the cache
+  void _save_cache() const;
+
 public:
   static GiNaC::symtab symtab;
 
@@ -86,8 +119,22 @@ private:
   GiNaC::ex _fPoly;
   // ibp relations prototype
   std::vector<IBPProto> _ibp;
+  // ibp relations prototype with polynomial coefficients
+  std::vector<IBPProtoPoly> _ibpPoly;
   // ibp relations prototype over finite field
   std::vector<IBPProtoFF> _ibpFF;
+  // values of the symbols in _ibpFF
+  std::vector<umod64> _ffValues;
+
+  // top sector of the trivial sectors search
+  unsigned _trivialTop = 0;
+  // non-trivial sectors under _trivialTop
+  std::vector<bool> _nonTrivial;
+
+  // cache directory, empty if caching is disabled
+  std::string _cacheDir;
+  // hash of the family config
+  uint64_t _hash = 0;
 };
 
 class Reduce {
@@ -98,6 +145,9 @@ public:
   // print reduciton job info
   void print() const;
 
+  // the reduction jobs
+  const std::vector<Sector> &sectors() const { return _reduceSectors; }
+
   friend class Family;
 
 private:
@@ -120,4 +170,34 @@ private:
   std::vector<bool> _sectors;
   // the reduction jobs
   std::vector<Sector> _reduceSectors;
+  // checkpoints of the reduction jobs
+  Checkpoint _checkpoint;
+  // progress of the reduction jobs
+  Progress _progress;
+  // bits of the prime of the reduction field: 63, 50 or 31
+  unsigned _field = 63;
+  // memory budget of each sector system in bytes, 0 if unlimited
+  uint64_t _memoryBudget = 0;
+  // directory of the spill files
+  std::string _spillPath;
+  // directory of the reduction tables, empty if they are not written
+  std::string _tablePath = ".";
+  // worker threads of the sector reductions
+  unsigned _threads = 1;
+  // bind the workers to the NUMA nodes, a sector stays on one node
+  bool _numa = false;
+  // generated sector systems waiting for the elimination on each node, 0 if
+  // the sectors are generated and eliminated serially
+  unsigned _pipeline = 0;
+  // address the coordinator listens on, empty if not a coordinator
+  std::string _serve;
+  // connection to the coordinator, nullptr if not a worker
+  std::unique_ptr<Connection> _coordinator;
+  // sample points evaluated instead of the reduction, 0 for the reduction
+  uint64_t _samples = 0;
+  // sector of the samples
+  unsigned _sampleSector = 0;
+  // number of the first sample point and seed of the points
+  uint64_t _sampleFirst = 0;
+  uint64_t _sampleSeed = 1;
 };
\ No newline at end of file
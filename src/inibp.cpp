@@ -1,6 +1,11 @@
 #include "inibp.h"
+#include "log.h"
+#include "stats.h"
 
 InIBP::InIBP(const YAML::Node &node) : _family(node) {
+  if (node["report"] && !node["report"].IsNull())
+    _report = node["report"].as<std::string>();
+
   _family.init();
   _family.init_reduce(node, _reduce);
 
@@ -8,4 +13,11 @@ InIBP::InIBP(const YAML::Node &node) : _family(node) {
   _reduce.print();
 }
 
-void InIBP::run() { _family.run_reduce(_reduce); }
\ No newline at end of file
+void InIBP::run() {
+  _family.run_reduce(_reduce);
+
+  if (!_report.empty()) {
+    Stats::write_report(_report);
+    LOG_DEBUG("report written to " << _report);
+  }
+}
\ No newline at end of file
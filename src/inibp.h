@@ -17,4 +17,6 @@ public:
 private:
   Family _family;
   Reduce _reduce;
+  // path of the JSON report, empty if no report is written
+  std::string _report;
 };
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+std::atomic<unsigned> Log::_level{(unsigned)LogLevel::Info};
+
+namespace {
+
+// lines of one thread not written yet
+struct LogBuffer {
+  std::mutex mutex;
+  std::string data;
+};
+
+// buffered lines are written after this many bytes or this interval
+const size_t LOG_BUFFER_BYTES = 1 << 14;
+const auto LOG_FLUSH_INTERVAL = std::chrono::milliseconds(100);
+
+// the buffers of all threads and the thread writing them
+class LogWriter {
+public:
+  LogWriter() : _thread(&LogWriter::_run, this) {}
+
+  ~LogWriter() {
+    {
+      std::lock_guard lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+  }
+
+  // the buffer of the calling thread
+  LogBuffer &buffer() {
+    thread_local std::shared_ptr<LogBuffer> local = _register();
+    return *local;
+  }
+
+  // a buffer is full, wake the writer
+  void notify() {
+    {
+      std::lock_guard lock(_mutex);
+      _full = true;
+    }
+    _wake.notify_one();
+  }
+
+  // write the buffers now and wait until they are written
+  void flush() {
+    std::unique_lock lock(_mutex);
+    uint64_t target = ++_requested;
+    _wake.notify_one();
+    _flushed.wait(lock, [&] { return _written >= target || _stop; });
+  }
+
+private:
+  std::shared_ptr<LogBuffer> _register() {
+    auto buffer = std::make_shared<LogBuffer>();
+    std::lock_guard lock(_mutex);
+    _buffers.push_back(buffer);
+    return buffer;
+  }
+
+  // move the lines out of all buffers and write them
+  // buffers of finished threads are dropped once empty
+  void _drain() {
+    std::vector<std::shared_ptr<LogBuffer>> buffers;
+    {
+      std::lock_guard lock(_mutex);
+      std::erase_if(_buffers, [](const auto &buffer) {
+        std::lock_guard bufferLock(buffer->mutex);
+        return buffer.use_count() == 1 && buffer->data.empty();
+      });
+      buffers = _buffers;
+    }
+    std::string data;
+    for (const auto &buffer : buffers) {
+      {
+        std::lock_guard lock(buffer->mutex);
+        data.swap(buffer->data);
+      }
+      if (!data.empty()) {
+        std::fwrite(data.data(), 1, data.size(), stdout);
+        data.clear();
+      }
+    }
+    std::fflush(stdout);
+  }
+
+  void _run() {
+    std::unique_lock lock(_mutex);
+    while (true) {
+      _wake.wait_for(lock, LOG_FLUSH_INTERVAL, [this] {
+        return _stop || _full || _requested > _written;
+      });
+      _full = false;
+      bool stop = _stop;
+      uint64_t requested = _requested;
+      lock.unlock();
+      _drain();
+      lock.lock();
+      _written = requested;
+      _flushed.notify_all();
+      if (stop)
+        return;
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _flushed;
+  std::vector<std::shared_ptr<LogBuffer>> _buffers;
+  // flush requests made and served
+  uint64_t _requested = 0;
+  uint64_t _written = 0;
+  bool _full = false;
+  bool _stop = false;
+  std::thread _thread;
+};
+
+LogWriter &writer() {
+  static LogWriter writer;
+  return writer;
+}
+
+} // namespace
+
+LogLevel Log::parse_level(const std::string &name) {
+  if (name == "error")
+    return LogLevel::Error;
+  if (name == "warning")
+    return LogLevel::Warning;
+  if (name == "info")
+    return LogLevel::Info;
+  if (name == "debug")
+    return LogLevel::Debug;
+  if (name == "trace")
+    return LogLevel::Trace;
+  throw std::runtime_error("unknown log level " + name);
+}
+
+void Log::write(const std::string &line) {
+  LogWriter &logWriter = writer();
+  LogBuffer &buffer = logWriter.buffer();
+  size_t size;
+  {
+    std::lock_guard lock(buffer.mutex);
+    buffer.data += line;
+    buffer.data += '\n';
+    size = buffer.data.size();
+  }
+  if (size >= LOG_BUFFER_BYTES)
+    logWriter.notify();
+}
+
+void Log::flush() { writer().flush(); }
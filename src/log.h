@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+// levels of the log messages, a message is written if its level is not
+// above the level of the log
+enum class LogLevel : unsigned { Error, Warning, Info, Debug, Trace };
+
+// the most verbose level compiled in, statements above it are removed
+#ifndef INIBP_LOG_MAX_LEVEL
+#define INIBP_LOG_MAX_LEVEL 3
+#endif
+
+// process wide log to stdout, thread safe
+// messages are appended to a buffer of the calling thread and written by a
+// background thread, the buffers are never flushed inside the caller
+class Log {
+public:
+  static void set_level(LogLevel level) {
+    _level.store((unsigned)level, std::memory_order_relaxed);
+  }
+
+  // parse a level name: error, warning, info, debug or trace
+  static LogLevel parse_level(const std::string &);
+
+  static bool enabled(LogLevel level) {
+    return (unsigned)level <= _level.load(std::memory_order_relaxed);
+  }
+
+  // append a line to the buffer of the calling thread
+  static void write(const std::string &);
+  // write all buffered lines and wait for them
+  static void flush();
+
+private:
+  static std::atomic<unsigned> _level;
+};
+
+// log a line at a level, the arguments are streamed into the line
+// LOG(Debug, "sector " << id << " done")
+#define LOG(LEVEL, ...)                                                        \
+  do {                                                                         \
+    if constexpr ((unsigned)LogLevel::LEVEL <= INIBP_LOG_MAX_LEVEL) {          \
+      if (Log::enabled(LogLevel::LEVEL)) {                                     \
+        std::ostringstream log_line_;                                          \
+        log_line_ << __VA_ARGS__;                                              \
+        Log::write(log_line_.str());                                           \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define LOG_ERROR(...) LOG(Error, __VA_ARGS__)
+#define LOG_WARNING(...) LOG(Warning, __VA_ARGS__)
+#define LOG_INFO(...) LOG(Info, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG(Debug, __VA_ARGS__)
+#define LOG_TRACE(...) LOG(Trace, __VA_ARGS__)
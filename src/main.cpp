@@ -1,11 +1,14 @@
 #include <chrono>
 #include <ctime>
+#include <exception>
+#include <iomanip>
 #include <iostream>
 
 #include "CLI11.hpp"
 #include "yaml-cpp/yaml.h"
 
 #include "inibp.h"
+#include "log.h"
 #include <flint/nmod_vec.h>
 
 #include <fflow/alg_functions.hh>
@@ -15,36 +18,70 @@
 
 using namespace fflow;
 
+// handler replaced by the one writing the buffered log
+static std::terminate_handler defaultTerminate = nullptr;
+
 int main(int argc, char **argv) {
   auto now = std::chrono::system_clock::now();
   std::time_t currentTime = std::chrono::system_clock::to_time_t(now);
   std::tm *localtime = std::localtime(&currentTime);
-  std::cout << "\nProgram begin: " << std::asctime(localtime);
 
   CLI::App app;
 
   std::string configPath;
   app.add_option("CONFIG", configPath, "The config file to read")
       ->type_name("");
+  bool resume = false;
+  app.add_flag("--resume", resume, "Resume from the checkpoints");
+  std::string serve, worker;
+  app.add_option("--serve", serve,
+                 "Coordinate worker processes on unix:PATH or HOST:PORT");
+  app.add_option("--worker", worker,
+                 "Reduce the jobs of the coordinator on unix:PATH or HOST:PORT");
+  std::string logLevel = "info";
+  app.add_option("--log-level", logLevel,
+                 "Log level: error, warning, info, debug or trace");
 
   CLI11_PARSE(app, argc, argv)
 
-  std::cout
-      << "\n--------------- \033[35mInIBP is not IBP\033[0m ---------------"
-      << std::endl;
+  // keep the buffered log of a crash, e.g. an exception of a worker thread
+  defaultTerminate = std::set_terminate([] {
+    Log::flush();
+    if (defaultTerminate)
+      defaultTerminate();
+    std::abort();
+  });
+
   try {
+    Log::set_level(Log::parse_level(logLevel));
+    LOG_INFO("\nProgram begin: " << std::put_time(localtime, "%c"));
+    LOG_INFO(
+        "\n--------------- \033[35mInIBP is not IBP\033[0m ---------------");
+
     YAML::Node config = YAML::LoadFile(configPath);
+    if (resume) {
+      if (!config["checkpoint"] || config["checkpoint"].IsNull())
+        throw std::runtime_error("checkpoint not found, cannot resume");
+      config["checkpoint"]["resume"] = true;
+    }
+    if (!serve.empty())
+      config["cluster"]["serve"] = serve;
+    if (!worker.empty()) {
+      config["cluster"]["worker"] = worker;
+      config.remove("checkpoint");
+    }
     // YAML::Node config =
     //     YAML::LoadFile("/home/chiyutuci/Works/inibp/example/1.yaml");
     InIBP inibp(config);
 
     inibp.run();
-  } catch (std::runtime_error &e) {
+  } catch (std::exception &e) {
+    Log::flush();
     std::cerr << "\n \033[1m\033[31mError:\033[0m " << e.what() << "\n"
               << std::endl;
     return EXIT_FAILURE;
   }
 
-  std::cout << std::endl;
+  LOG_INFO("");
   return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+NumaTopology::NumaTopology() {
+  // node directories are nodeN, N may have gaps
+  std::vector<std::pair<unsigned, std::vector<unsigned>>> nodes;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(
+           "/sys/devices/system/node", error)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+        !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+      continue;
+    std::ifstream file(entry.path() / "cpulist");
+    std::string list;
+    std::getline(file, list);
+    std::vector<unsigned> cpus = parse_cpulist(list);
+    if (!cpus.empty())
+      nodes.emplace_back(std::stoul(name.substr(4)), std::move(cpus));
+  }
+  std::sort(nodes.begin(), nodes.end());
+  for (auto &node : nodes)
+    _cpus.emplace_back(std::move(node.second));
+
+  if (_cpus.empty()) {
+    _cpus.emplace_back();
+    for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+      _cpus.back().push_back(cpu);
+  }
+}
+
+const NumaTopology &NumaTopology::get() {
+  static NumaTopology topology;
+  return topology;
+}
+
+std::vector<unsigned> NumaTopology::parse_cpulist(const std::string &list) {
+  std::vector<unsigned> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || !::isdigit(range[0]))
+      continue;
+    size_t dash = range.find('-');
+    unsigned first = std::stoul(range.substr(0, dash));
+    unsigned last =
+        dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+    for (unsigned cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+bool bind_to_node(unsigned node) {
+  const NumaTopology &topology = NumaTopology::get();
+  if (node >= topology.nodes())
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu : topology.cpus(node))
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// NUMA nodes of the machine and their cpus, read from /sys/devices/system/node
+// a machine without the information has a single node with all the cpus
+class NumaTopology {
+public:
+  // the topology of this machine
+  static const NumaTopology &get();
+
+  // number of nodes with cpus
+  [[nodiscard]] unsigned nodes() const { return _cpus.size(); }
+
+  // cpus of the i-th node
+  [[nodiscard]] const std::vector<unsigned> &cpus(unsigned node) const {
+    return _cpus[node];
+  }
+
+  // parse a cpu list such as 0-3,8,10-11
+  static std::vector<unsigned> parse_cpulist(const std::string &);
+
+private:
+  NumaTopology();
+
+private:
+  std::vector<std::vector<unsigned>> _cpus;
+};
+
+// bind the calling thread to the cpus of a node, false if it failed
+// memory the thread touches first is then allocated on the node
+bool bind_to_node(unsigned node);
@@ -0,0 +1,119 @@
+#include "progress.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+// format seconds as hh:mm:ss
+static std::string format_time(double seconds) {
+  if (seconds < 0 || seconds > 1e8)
+    return "--:--:--";
+  auto s = (unsigned long)seconds;
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%02lu:%02lu:%02lu", s / 3600, s / 60 % 60,
+                s % 60);
+  return buf;
+}
+
+void Progress::start(unsigned nsectors, unsigned parallel) {
+  std::lock_guard lock(_mutex);
+  _nsectors = nsectors;
+  _parallel = std::max(1u, parallel);
+  _done = 0;
+  _reduced = 0;
+  _reducedTime = 0;
+  _start = clock::now();
+  _running.clear();
+}
+
+void Progress::sector_begin(unsigned sector, size_t nequations,
+                            size_t first) {
+  if (!enabled())
+    return;
+  std::lock_guard lock(_mutex);
+  _running[sector] = {nequations, first, first, clock::now(),
+                      Stats::current_memory()};
+}
+
+void Progress::update(unsigned sector, size_t processed) {
+  if (!enabled())
+    return;
+  // cheap check before taking the lock
+  auto now = clock::now().time_since_epoch().count();
+  auto interval = std::chrono::duration_cast<clock::duration>(
+                      std::chrono::duration<double>(_interval))
+                      .count();
+  if (now - _last.load(std::memory_order_relaxed) < interval)
+    return;
+
+  std::lock_guard lock(_mutex);
+  if (auto it = _running.find(sector); it != _running.end())
+    it->second.processed = processed;
+  _report(false);
+}
+
+void Progress::sector_end(unsigned sector) {
+  if (!enabled())
+    return;
+  std::lock_guard lock(_mutex);
+  if (auto it = _running.find(sector); it != _running.end()) {
+    _reducedTime +=
+        std::chrono::duration<double>(clock::now() - it->second.start).count();
+    ++_reduced;
+    _running.erase(it);
+  }
+  ++_done;
+  _report(true);
+}
+
+void Progress::_report(bool force) {
+  auto now = clock::now();
+  auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(_interval));
+  if (!force && now.time_since_epoch().count() - _last.load() < interval.count())
+    return;
+  _last = now.time_since_epoch().count();
+
+  double elapsed = std::chrono::duration<double>(now - _start).count();
+  uint64_t memory = Stats::current_memory();
+
+  // remaining time: the running sectors by their rates, the waiting sectors
+  // by the average time of the ones reduced in this run, parallel at once
+  double remaining = 0;
+  uint64_t memoryEstimate = memory;
+  std::string sectors;
+  for (const auto &[id, running] : _running) {
+    double time = std::chrono::duration<double>(now - running.start).count();
+    double rate =
+        time > 0 ? (double)(running.processed - running.first) / time : 0;
+    double left = rate > 0 ? (double)(running.total - running.processed) / rate
+                           : -1;
+    remaining = left < 0 || remaining < 0 ? -1 : std::max(remaining, left);
+    // memory grows roughly linearly with the processed equations
+    if (running.processed > running.first && memory > running.memory)
+      memoryEstimate +=
+          (uint64_t)((double)(memory - running.memory) *
+                     (double)(running.total - running.processed) /
+                     (double)(running.processed - running.first));
+
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "  #%u %zu/%zu eqs %.0f rows/s", id,
+                  running.processed, running.total, rate);
+    sectors += buf;
+  }
+  unsigned waiting = _nsectors - _done - _running.size();
+  if (remaining >= 0 && waiting > 0) {
+    double average = _reduced > 0 ? _reducedTime / _reduced : -1;
+    double rounds = std::ceil((double)waiting / _parallel);
+    remaining = average < 0 ? -1 : remaining + average * rounds;
+  }
+
+  std::fprintf(stderr,
+               " \033[36m[progress]\033[0m sectors %u/%u%s  elapsed %s  "
+               "remaining %s  memory %.2f GB (est. %.2f GB)\n",
+               _done, _nsectors, sectors.c_str(), format_time(elapsed).c_str(),
+               format_time(remaining).c_str(), (double)memory / (1 << 30),
+               (double)memoryEstimate / (1 << 30));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+// live progress of the sector reductions, thread safe and rate limited
+// reports are written to stderr
+class Progress {
+public:
+  // interval: minimum seconds between reports, 0 disables the reports
+  void set_interval(double interval) { _interval = interval; }
+
+  [[nodiscard]] bool enabled() const { return _interval > 0; }
+
+  // start the reduction of nsectors sectors, parallel of them at once
+  void start(unsigned nsectors, unsigned parallel = 1);
+
+  // a sector starts eliminating nequations equations
+  // first: equations processed before, restored from a snapshot
+  void sector_begin(unsigned sector, size_t nequations, size_t first = 0);
+  // processed equations of a running sector
+  void update(unsigned sector, size_t processed);
+  // a sector finishes
+  void sector_end(unsigned sector);
+
+private:
+  // print a report if one is due, force: print anyway
+  void _report(bool force);
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  // state of a running sector
+  struct Running {
+    size_t total = 0;
+    size_t first = 0;
+    size_t processed = 0;
+    clock::time_point start;
+    // resident memory when the sector started
+    uint64_t memory = 0;
+  };
+
+  double _interval = 0;
+  std::mutex _mutex;
+  unsigned _nsectors = 0;
+  unsigned _parallel = 1;
+  unsigned _done = 0;
+  // sectors reduced in this run and the seconds spent in them, the sectors
+  // completed in a previous run are only counted in _done
+  unsigned _reduced = 0;
+  double _reducedTime = 0;
+  clock::time_point _start;
+  std::atomic<clock::rep> _last{0};
+  std::map<unsigned, Running> _running;
+};
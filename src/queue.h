@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// blocking queue of at most capacity items, thread safe
+// push waits while the queue is full, pop waits while it is empty
+// after close, pop drains the remaining items and then returns nullopt
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : _capacity(capacity) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  void push(T &&item) {
+    std::unique_lock lock(_mutex);
+    _notFull.wait(lock, [this] { return _items.size() < _capacity; });
+    _items.emplace_back(std::move(item));
+    lock.unlock();
+    _notEmpty.notify_one();
+  }
+
+  std::optional<T> pop() {
+    std::unique_lock lock(_mutex);
+    _notEmpty.wait(lock, [this] { return !_items.empty() || _closed; });
+    if (_items.empty())
+      return std::nullopt;
+    std::optional<T> item(std::move(_items.front()));
+    _items.pop_front();
+    lock.unlock();
+    _notFull.notify_one();
+    return item;
+  }
+
+  // no more items will be pushed
+  void close() {
+    {
+      std::lock_guard lock(_mutex);
+      _closed = true;
+    }
+    _notEmpty.notify_all();
+  }
+
+private:
+  size_t _capacity;
+  std::mutex _mutex;
+  std::condition_variable _notFull;
+  std::condition_variable _notEmpty;
+  std::deque<T> _items;
+  bool _closed = false;
+};
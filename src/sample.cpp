@@ -0,0 +1,318 @@
+#include "sample.h"
+#include "queue.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <numeric>
+#include <span>
+#include <thread>
+
+// LearnedSector
+
+template <typename T>
+LearnedSector<T>::LearnedSector(const Sector &sector,
+                                const std::vector<IBPProtoSym> &ibps,
+                                const std::vector<T> &probe) {
+  Sector job = sector;
+  job._generate_seeds();
+  _id = job._id;
+  _nprops = job._nprops;
+  _seeds = std::move(job._seeds);
+  for (const auto &seed : _seeds)
+    for (unsigned k = 0; k < _nprops; ++k)
+      _indices.push_back(T::from(seed[k]));
+
+  // the coefficients over the field, once for all points
+  std::vector<std::vector<unsigned>> termOf;
+  for (const auto &ibp : ibps) {
+    termOf.emplace_back();
+    for (const auto &item : ibp) {
+      termOf.back().push_back(_polys.size() / (_nprops + 1));
+      for (const auto &coeff : item.second)
+        _polys.push_back(coeff.template transform<T>(
+            [](const Rational &num) { return num.to_mod<T>(); }));
+    }
+  }
+
+  // the integrals of the equations, as in Sector::_generate_system
+  for (unsigned s = 0; s < _seeds.size(); ++s) {
+    const auto &seed = _seeds[s];
+    if (seed.depth() >= job._depth || seed.rank() >= job._rank)
+      continue;
+    _inner.push_back(s);
+    for (unsigned i = 0; i < ibps.size(); ++i) {
+      size_t begin = _terms.size();
+      for (unsigned j = 0; j < ibps[i].size(); ++j) {
+        auto weight = job._weights.find(seed + ibps[i][j].first);
+        if (weight != job._weights.end())
+          _terms.emplace_back(weight->second, termOf[i][j]);
+      }
+      if (_terms.size() != begin) {
+        _offsets.push_back(_terms.size());
+        _generators.push_back(s);
+      }
+    }
+  }
+
+  Scratch probeScratch = scratch();
+  _reduce(probe, probeScratch);
+  for (unsigned s : _inner)
+    if (probeScratch.lineNumber[s] == NO_PIVOT)
+      _masters.push_back(s);
+}
+
+template <typename T>
+typename LearnedSector<T>::Scratch LearnedSector<T>::scratch() const {
+  Scratch scratch;
+  scratch.coeffs.resize(_polys.size());
+  scratch.spa = SparseAccumulator<T>(_seeds.size());
+  return scratch;
+}
+
+template <typename T>
+void LearnedSector<T>::_reduce(const std::vector<T> &point,
+                               Scratch &scratch) const {
+  for (size_t i = 0; i < _polys.size(); ++i)
+    scratch.coeffs[i] = _polys[i].evaluate(point);
+
+  // the coefficient of a term is c_0 + seed[0] * c_1 + ... + seed[n-1] * c_n
+  auto &terms = scratch.terms;
+  auto &rows = scratch.rows;
+  terms.clear();
+  rows.assign(1, 0);
+  for (size_t e = 0; e < size(); ++e) {
+    const T *indices = &_indices[(size_t)_generators[e] * _nprops];
+    for (size_t t = _offsets[e]; t < _offsets[e + 1]; ++t) {
+      const T *coeffs =
+          &scratch.coeffs[(size_t)_terms[t].second * (_nprops + 1)];
+      T coeff = coeffs[_nprops] + vec_dot(coeffs, indices, _nprops);
+      if (coeff == 0)
+        continue;
+      terms.emplace_back(_terms[t].first, coeff);
+    }
+    if (terms.size() == rows.back())
+      continue;
+    std::sort(terms.begin() + (long)rows.back(), terms.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+    rows.push_back(terms.size());
+  }
+
+  // order the rows like EquationMod::operator<: by the first integral, then
+  // by size, then as generated
+  size_t nrows = rows.size() - 1;
+  auto &order = scratch.order;
+  auto &buckets = scratch.buckets;
+  buckets.assign(_seeds.size() + 1, 0);
+  for (size_t r = 0; r < nrows; ++r)
+    ++buckets[terms[rows[r]].first + 1];
+  std::partial_sum(buckets.begin(), buckets.end(), buckets.begin());
+  order.resize(nrows);
+  for (size_t r = 0; r < nrows; ++r)
+    order[buckets[terms[rows[r]].first]++] = r;
+  for (size_t k = 0; k < _seeds.size(); ++k) {
+    unsigned begin = k == 0 ? 0 : buckets[k - 1];
+    if (buckets[k] - begin > 1)
+      std::stable_sort(order.begin() + begin, order.begin() + buckets[k],
+                       [&rows](unsigned a, unsigned b) {
+                         return rows[a + 1] - rows[a] < rows[b + 1] - rows[b];
+                       });
+  }
+
+  // gauss elimination
+  auto &pivotTerms = scratch.pivotTerms;
+  auto &pivots = scratch.pivots;
+  auto &spa = scratch.spa;
+  pivotTerms.clear();
+  pivots.assign(1, 0);
+  scratch.lineNumber.assign(_seeds.size(), NO_PIVOT);
+  for (unsigned r : order) {
+    spa.reduce({terms.data() + rows[r], rows[r + 1] - rows[r]},
+               scratch.lineNumber, [&](unsigned line) {
+                 return std::span<const std::pair<unsigned, T>>(
+                     pivotTerms.data() + pivots[line],
+                     pivots[line + 1] - pivots[line]);
+               });
+    if (spa.weights().empty())
+      continue;
+    scratch.lineNumber[spa.weights()[0]] = pivots.size() - 1;
+    for (size_t i = 0; i < spa.weights().size(); ++i)
+      pivotTerms.emplace_back(spa.weights()[i], spa.coeffs()[i]);
+    pivots.push_back(pivotTerms.size());
+  }
+}
+
+template <typename T>
+Sample<T> LearnedSector<T>::evaluate(uint64_t index, std::vector<T> point,
+                                     Scratch &scratch) const {
+  _reduce(point, scratch);
+
+  Sample<T> sample;
+  sample.index = index;
+  sample.point = std::move(point);
+  auto master = _masters.begin();
+  for (unsigned s : _inner) {
+    if (scratch.lineNumber[s] != NO_PIVOT)
+      continue;
+    if (master == _masters.end() || *master != s) {
+      sample.unlucky = true;
+      break;
+    }
+    ++master;
+  }
+  sample.unlucky = sample.unlucky || master != _masters.end();
+
+  // pivot rows: integral = -sum coeff * integral
+  for (size_t p = 0; p + 1 < scratch.pivots.size(); ++p) {
+    const auto *row = &scratch.pivotTerms[scratch.pivots[p]];
+    size_t nterms = scratch.pivots[p + 1] - scratch.pivots[p];
+    std::vector<std::pair<unsigned, T>> terms;
+    terms.reserve(nterms - 1);
+    for (size_t i = 1; i < nterms; ++i)
+      terms.emplace_back(row[i].first, -row[i].second);
+    sample.rows.emplace_back(row[0].first, std::move(terms));
+  }
+  return sample;
+}
+
+// SampleFarm
+
+template <typename T>
+SampleFarm<T>::SampleFarm(const LearnedSector<T> &sector,
+                          TaskScheduler &scheduler)
+    : _sector(sector), _scheduler(scheduler) {
+  for (unsigned i = 0; i < scheduler.size(); ++i)
+    _free.push_back(std::make_unique<Scratch>(sector.scratch()));
+}
+
+template <typename T>
+std::unique_ptr<typename SampleFarm<T>::Scratch> SampleFarm<T>::_borrow() {
+  {
+    std::lock_guard lock(_mutex);
+    if (!_free.empty()) {
+      auto scratch = std::move(_free.back());
+      _free.pop_back();
+      return scratch;
+    }
+  }
+  return std::make_unique<Scratch>(_sector.scratch());
+}
+
+template <typename T>
+void SampleFarm<T>::_give_back(std::unique_ptr<Scratch> scratch) {
+  std::lock_guard lock(_mutex);
+  _free.push_back(std::move(scratch));
+}
+
+template <typename T>
+double SampleFarm<T>::run(
+    uint64_t first, uint64_t count,
+    const std::function<std::vector<T>(uint64_t)> &point,
+    const std::function<void(Sample<T> &&)> &sink, unsigned backlog) {
+  auto start = std::chrono::steady_clock::now();
+  BoundedQueue<Sample<T>> queue(std::max(1u, backlog));
+  // next point to evaluate, count once the run fails
+  std::atomic<uint64_t> next{0};
+  TaskGroup group(_scheduler);
+  for (unsigned k = 0; k < _scheduler.size(); ++k)
+    group.submit([this, &queue, &point, &next, first, count] {
+      auto scratch = _borrow();
+      try {
+        for (uint64_t i; (i = next.fetch_add(1)) < count;)
+          queue.push(_sector.evaluate(first + i, point(first + i), *scratch));
+      } catch (...) {
+        next.store(count);
+        throw;
+      }
+      _give_back(std::move(scratch));
+    });
+
+  // the queue is closed when all the samples are evaluated
+  std::exception_ptr error;
+  std::thread waiter([&] {
+    try {
+      group.wait();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    queue.close();
+  });
+  try {
+    while (auto sample = queue.pop()) {
+      Stats::count(Counter::Samples, 1);
+      if (sample->unlucky)
+        Stats::count(Counter::UnluckySamples, 1);
+      sink(std::move(*sample));
+    }
+  } catch (...) {
+    // stop the tasks and drain the queue so they can finish
+    next.store(count);
+    while (queue.pop())
+      ;
+    waiter.join();
+    throw;
+  }
+  waiter.join();
+  if (error)
+    std::rethrow_exception(error);
+
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  return seconds.count() > 0 ? count / seconds.count() : 0;
+}
+
+// SampleWriter
+
+template <typename T>
+SampleWriter<T>::SampleWriter(const std::string &path,
+                              const LearnedSector<T> &sector,
+                              unsigned nsymbols)
+    : _file(path, std::ios::binary | std::ios::trunc), _path(path),
+      _nsymbols(nsymbols) {
+  if (!_file)
+    throw std::runtime_error("cannot write samples " + path);
+  write_binary(_file, SAMPLE_MAGIC);
+  write_binary(_file, SAMPLE_VERSION);
+  write_binary<uint32_t>(_file, sector.id());
+  write_binary<uint64_t>(_file, T::modulus());
+  write_binary<uint32_t>(_file, nsymbols);
+  unsigned nprops = sector.seeds().empty() ? 0 : sector.seeds()[0].size();
+  write_binary<uint32_t>(_file, nprops);
+  write_binary<uint32_t>(_file, sector.seeds().size());
+  for (const auto &seed : sector.seeds())
+    for (unsigned k = 0; k < nprops; ++k)
+      write_binary<int32_t>(_file, seed[k]);
+  write_binary<uint32_t>(_file, sector.masters().size());
+  for (unsigned master : sector.masters())
+    write_binary<uint32_t>(_file, master);
+}
+
+template <typename T> void SampleWriter<T>::write(const Sample<T> &sample) {
+  write_binary<uint64_t>(_file, sample.index);
+  for (unsigned i = 0; i < _nsymbols; ++i)
+    write_binary<uint64_t>(_file, sample.point[i].value());
+  write_binary<uint32_t>(_file, sample.unlucky);
+  write_binary<uint32_t>(_file, sample.rows.size());
+  for (const auto &row : sample.rows) {
+    write_binary<uint32_t>(_file, row.first);
+    write_binary<uint32_t>(_file, row.second.size());
+    for (const auto &term : row.second) {
+      write_binary<uint32_t>(_file, term.first);
+      write_binary<uint64_t>(_file, term.second.value());
+    }
+  }
+  if (!_file)
+    throw std::runtime_error("cannot write samples " + _path);
+}
+
+template class LearnedSector<umod64>;
+template class LearnedSector<umod50>;
+template class LearnedSector<umod31>;
+template class SampleFarm<umod64>;
+template class SampleFarm<umod50>;
+template class SampleFarm<umod31>;
+template class SampleWriter<umod64>;
+template class SampleWriter<umod50>;
+template class SampleWriter<umod31>;
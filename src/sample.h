@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "arith/poly.h"
+#include "arith/umod.h"
+
+#include "equation.h"
+#include "sector.h"
+#include "tasks.h"
+
+// evaluation of a sector at a point of the symbols over the field of T
+template <typename T> struct Sample {
+  // number of the point
+  uint64_t index = 0;
+  // values of the symbols
+  std::vector<T> point;
+  // the masters differ from the learned ones
+  bool unlucky = false;
+  // reduced rows: integral = sum coeff * integral, integrals are seed numbers
+  std::vector<std::pair<unsigned, std::vector<std::pair<unsigned, T>>>> rows;
+};
+
+// the system of a sector learned once and evaluated at many points
+// the seeds and the ibp terms of each equation are fixed, an evaluation only
+// computes the coefficients at the point, sorts and eliminates
+// the masters are learned at the probe point
+template <typename T> class LearnedSector {
+public:
+  // buffers of an evaluation, reused by the next evaluations
+  // the rows are kept in flat arrays of terms, an evaluation only resets
+  // their sizes
+  struct Scratch {
+    // values of the coefficient polynomials at the point
+    std::vector<T> coeffs;
+    // terms of the generated rows, row r in [rows[r], rows[r + 1])
+    std::vector<std::pair<unsigned, T>> terms;
+    std::vector<size_t> rows;
+    // generated rows in the order of the elimination
+    std::vector<unsigned> order;
+    std::vector<unsigned> buckets;
+    // terms of the pivot rows, pivot p in [pivots[p], pivots[p + 1])
+    std::vector<std::pair<unsigned, T>> pivotTerms;
+    std::vector<size_t> pivots;
+    std::vector<unsigned> lineNumber;
+    SparseAccumulator<T> spa;
+  };
+
+  // ibps: the relations of Family::ibp_sym, polynomials in the symbols
+  LearnedSector(const Sector &, const std::vector<IBPProtoSym> &ibps,
+                const std::vector<T> &probe);
+
+  [[nodiscard]] unsigned id() const { return _id; }
+
+  // integral of each seed number
+  [[nodiscard]] const std::vector<RawIntegral> &seeds() const {
+    return _seeds;
+  }
+
+  // seed numbers of the masters at the probe point
+  [[nodiscard]] const std::vector<unsigned> &masters() const {
+    return _masters;
+  }
+
+  // number of equations of an evaluation
+  [[nodiscard]] size_t size() const { return _offsets.size() - 1; }
+
+  [[nodiscard]] Scratch scratch() const;
+
+  // evaluate the sector at a point
+  Sample<T> evaluate(uint64_t index, std::vector<T> point, Scratch &) const;
+
+private:
+  // generate and eliminate the system at the point into the scratch
+  void _reduce(const std::vector<T> &point, Scratch &) const;
+
+private:
+  unsigned _id = 0;
+  unsigned _nprops = 0;
+  std::vector<RawIntegral> _seeds;
+  // indices of the seeds over the field, _nprops per seed
+  std::vector<T> _indices;
+  // seeds inside the depth and the rank, candidates for the masters
+  std::vector<unsigned> _inner;
+  std::vector<unsigned> _masters;
+  // coefficients [c_1, ..., c_n, c_0] of the ibp terms, _nprops + 1 per term
+  std::vector<SparsePoly<T>> _polys;
+  // terms of the equations
+  //  first:  seed number of the integral
+  //  second: ibp term of the coefficient
+  std::vector<std::pair<unsigned, unsigned>> _terms;
+  // first term of each equation, the last one is the end
+  std::vector<size_t> _offsets{0};
+  // seed of each equation
+  std::vector<unsigned> _generators;
+};
+
+// evaluates a learned sector at many points on a task scheduler
+// a task per worker takes the next point until all are evaluated, and keeps
+// the scratch it borrowed from the farm, so nothing is rebuilt between the
+// samples and only the points being evaluated are in memory
+template <typename T> class SampleFarm {
+public:
+  SampleFarm(const LearnedSector<T> &sector, TaskScheduler &scheduler);
+
+  // evaluate the points first, ..., first + count - 1, point(index) makes
+  // the point of an index on the task evaluating it
+  // sink(sample) is called on the calling thread as the samples finish, in
+  // any order, at most backlog finished samples wait for it
+  // returns the samples per second
+  double run(uint64_t first, uint64_t count,
+             const std::function<std::vector<T>(uint64_t)> &point,
+             const std::function<void(Sample<T> &&)> &sink,
+             unsigned backlog);
+
+private:
+  using Scratch = typename LearnedSector<T>::Scratch;
+
+  // a free scratch, a new one if all are in use
+  std::unique_ptr<Scratch> _borrow();
+  void _give_back(std::unique_ptr<Scratch>);
+
+private:
+  const LearnedSector<T> &_sector;
+  TaskScheduler &_scheduler;
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<Scratch>> _free;
+};
+
+// the index-th point of a pseudo-random stream of points of nsymbols values
+// points of the same seed and index are equal in every process
+template <typename T>
+std::vector<T> sample_point(uint64_t seed, uint64_t index, unsigned nsymbols) {
+  std::vector<T> point;
+  uint64_t state = seed ^ (index * 0x9e3779b97f4a7c15);
+  for (unsigned i = 0; i < nsymbols; ++i) {
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    point.push_back(T::reduce(z ^ (z >> 31)));
+  }
+  return point;
+}
+
+// samples of a sector streamed to a file for the reconstruction
+//  header:  magic, uint32 version, uint32 sector, uint64 modulus,
+//           uint32 nsymbols, uint32 nprops, uint32 nseeds, int32 seeds
+//           [nseeds * nprops], uint32 nmasters, uint32 masters[nmasters]
+//  samples: uint64 index, uint64 point[nsymbols], uint32 unlucky,
+//           uint32 nrows, rows of uint32 integral, uint32 nterms and
+//           nterms times uint32 integral, uint64 coeff
+template <typename T> class SampleWriter {
+public:
+  SampleWriter(const std::string &path, const LearnedSector<T> &,
+               unsigned nsymbols);
+
+  void write(const Sample<T> &);
+
+private:
+  std::ofstream _file;
+  std::string _path;
+  unsigned _nsymbols;
+};
+
+const char SAMPLE_MAGIC[8] = {'I', 'N', 'I', 'B', 'P', 'S', 'P', '\0'};
+const uint32_t SAMPLE_VERSION = 1;
@@ -1,14 +1,25 @@
 #include "sector.h"
+#include "checkpoint.h"
+#include "log.h"
+#include "progress.h"
+#include "spill.h"
+#include "stats.h"
+#include "table.h"
+#include "tasks.h"
 
 #include <fflow/alg_functions.hh>
 #include <fflow/graph.hh>
 #include <fflow/numeric_solver.hh>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 using namespace fflow;
 
 std::map<std::pair<int, int>, std::vector<std::vector<int>>>
     Sector::combinations;
+std::mutex Sector::combinationsMutex;
 
 void Sector::generate_combinations(int number, int sum) {
   for (int num = 0; num <= number; ++num)
@@ -33,6 +44,8 @@ void Sector::generate_combinations(int number, int sum) {
 }
 
 void Sector::_generate_seeds() {
+  // the combinations are shared by the sectors running in parallel
+  std::lock_guard lock(combinationsMutex);
   int lines = std::popcount(_id);
   int zeros = (int)_nprops - lines;
   int number = std::max(lines, zeros);
@@ -74,11 +87,12 @@ void Sector::prepare_targets(const std::vector<RawIntegral> &targets) {
   _generate_seeds();
 }
 
-unsigned Sector::run_reduce(const std::vector<IBPProtoFF> &ibps) {
-  return sector_reduction(ibps);
+template <typename T>
+unsigned Sector::run_reduce(const std::vector<IBPProtoMod<T>> &ibps) {
+  return run_eliminate(run_generate(ibps));
 }
 
-unsigned Sector::run_reduce_sym(const std::vector<IBPProto> &ibps) {
+unsigned Sector::run_reduce_sym(const std::vector<IBPProtoSym> &ibps) {
   return sector_reduction_sym(ibps);
 }
 
@@ -87,93 +101,291 @@ unsigned Sector::run_reduce_ff(const std::vector<IBPProto> &ibps) {
   return sector_reduction_ff(ibps);
 }
 
-unsigned Sector::sector_reduction(const std::vector<IBPProtoFF> &ibps) {
-  // generate the system
+// order the equations like EquationMod::operator<
+// the first integrals are dense in [0, nweights), so the equations are
+// placed by a counting sort on them and each bucket is ordered by size
+// the equations must be given in ascending eqnum
+template <typename T>
+static void bucket_sort(std::vector<EquationMod<T>> &system,
+                        unsigned nweights) {
+  std::vector<unsigned> offsets(nweights + 1, 0);
+  for (const auto &equation : system)
+    ++offsets[equation.first_integral() + 1];
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<EquationMod<T>> sorted(system.size());
+  for (auto &equation : system)
+    sorted[offsets[equation.first_integral()]++] = std::move(equation);
+
+  // offsets[k] is now the end of the k-th bucket, the buckets are sorted
+  // in parallel when running on a task scheduler
+  parallel_for(0, nweights, 4096, [&](size_t k) {
+    unsigned begin = k == 0 ? 0 : offsets[k - 1];
+    if (offsets[k] - begin > 1)
+      std::stable_sort(sorted.begin() + begin, sorted.begin() + offsets[k],
+                       [](const EquationMod<T> &a, const EquationMod<T> &b) {
+                         return a.size() < b.size();
+                       });
+  });
+  std::swap(system, sorted);
+}
+
+template <typename T, unsigned N, typename F>
+uint64_t Sector::_generate_system(const std::vector<IBPProtoMod<T>> &ibps,
+                                  F emit) {
+  // indices of the seed over the field, on the stack for a fixed size
+  const unsigned nprops = N != 0 ? N : _nprops;
+  std::conditional_t<N != 0, std::array<T, N>, std::vector<T>> indices{};
+  if constexpr (N == 0)
+    indices.resize(_nprops);
+
+  uint64_t nzero = 0;
   for (const auto &seed : _seeds) {
     if (seed.depth() < _depth && seed.rank() < _rank) {
+      for (unsigned k = 0; k < nprops; ++k)
+        indices[k] = T::from(seed[k]);
       for (const auto &ibp : ibps) {
-        EquationFF equation;
+        EquationMod<T> equation;
         // generate the ibp equation
         for (const auto &item : ibp) {
-          RawIntegral integral = seed + item.first;
-          if (!_weights.contains(integral))
+          // fixed size indices are looked up without allocating
+          auto weight = _weights.end();
+          if constexpr (N != 0) {
+            FixedIntegral<N> key;
+            for (unsigned k = 0; k < N; ++k)
+              key[k] = seed[k] + item.first[k];
+            weight = _weights.find(key);
+          } else
+            weight = _weights.find(seed + item.first);
+          if (weight == _weights.end())
             continue;
           // check if coefficient is zero
-          umod64 coeff = item.second.back();
-          for (unsigned k = 0; k < _nprops; ++k)
-            if (item.second[k] != 0)
-              coeff += item.second[k] * umod64::from(seed[k]);
+          T coeff = item.second.back() +
+                    vec_dot(item.second.data(), indices.data(), nprops);
           if (coeff == 0)
             continue;
-          equation.insert(_weights[integral], coeff);
+          equation.insert(weight->second, coeff);
         }
-        if (equation.empty())
+        if (equation.empty()) {
+          ++nzero;
           continue;
-        else
+        } else
           equation.sort();
 
-        _systemFF.emplace_back(std::move(equation));
-        _systemFF.back().eqnum = _systemFF.size();
+        emit(std::move(equation));
       }
     }
   }
-  std::sort(_systemFF.begin(), _systemFF.end());
+  return nzero;
+}
+
+template <typename T>
+SectorSystem<T>
+Sector::run_generate(const std::vector<IBPProtoMod<T>> &ibps) {
+  _generate_seeds();
+  SectorSystem<T> system;
+  auto &systemFF = system.equations;
+
+  // equations over the memory budget are sorted and spilled to disk as a
+  // run, the runs are merged into the elimination
+  uint64_t systemBytes = 0;
+  auto spill_system = [&]() {
+    if (!system.spill)
+      system.spill = std::make_unique<SpillFile>(_spillPath);
+    bucket_sort(systemFF, _seeds.size());
+    system.spill->write_run(systemFF);
+    system.nspilled += systemFF.size();
+    systemFF.clear();
+    systemBytes = 0;
+  };
+
+  // generate the system
+  auto emit = [&](EquationMod<T> &&equation) {
+    systemFF.emplace_back(std::move(equation));
+    systemFF.back().eqnum = ++system.size;
+    if (_memoryBudget != 0) {
+      systemBytes += systemFF.back().bytes();
+      if (systemBytes > _memoryBudget)
+        spill_system();
+    }
+  };
+  std::optional<ScopedTimer> timer;
+  timer.emplace("generate", _id);
+  // specialized for the sizes of the examples
+  switch (_nprops) {
+  case 4:
+    system.nzero += _generate_system<T, 4>(ibps, emit);
+    break;
+  case 9:
+    system.nzero += _generate_system<T, 9>(ibps, emit);
+    break;
+  case 12:
+    system.nzero += _generate_system<T, 12>(ibps, emit);
+    break;
+  case 14:
+    system.nzero += _generate_system<T, 14>(ibps, emit);
+    break;
+  case 15:
+    system.nzero += _generate_system<T, 15>(ibps, emit);
+    break;
+  default:
+    system.nzero += _generate_system<T, 0>(ibps, emit);
+  }
+  timer.emplace("sort", _id);
+  if (system.spill)
+    spill_system();
+  else
+    bucket_sort(systemFF, _seeds.size());
+  return system;
+}
+
+template <typename T> unsigned Sector::run_eliminate(SectorSystem<T> &&system) {
+  std::optional<ScopedTimer> timer;
+  timer.emplace("eliminate", _id);
+  unsigned nsystem = system.size;
+  auto &systemFF = system.equations;
+  std::vector<EquationMod<T>> gaussFF;
+  std::optional<RunMerger<T>> merger;
+  if (system.spill)
+    merger.emplace(*system.spill);
+
+  // restore the snapshot of a previous run
+  _lineNumber.assign(_seeds.size(), NO_PIVOT);
+  unsigned start = 0;
+  EliminationCounters counters;
+  if (_checkpoint) {
+    start = _checkpoint->load_snapshot(_id, counters, gaussFF);
+    for (unsigned i = 0; i < gaussFF.size(); ++i)
+      _lineNumber[gaussFF[i].first_integral()] = i;
+    // the merged runs are consumed from the beginning
+    for (unsigned n = 0; merger && n < start; ++n)
+      merger->next();
+  }
+  auto lastSnapshot = std::chrono::steady_clock::now();
+  if (_progress)
+    _progress->sector_begin(_id, nsystem, start);
 
   // gauss elimination
-  for (auto &equation : _systemFF) {
-    while (!equation.empty() && _lineNumber.contains(equation[0])) {
-      equation.eliminate(_gaussFF[_lineNumber[equation[0]]], 0);
+  SparseAccumulator<T> spa(_seeds.size());
+  spa.eliminations = counters.eliminations;
+  spa.fillIn = counters.fillIn;
+  for (unsigned n = start; n < nsystem; ++n) {
+    if (_progress && n % 256 == 0)
+      _progress->update(_id, n);
+    if (_checkpoint && n % 1024 == 0 &&
+        _checkpoint->snapshot_due(lastSnapshot)) {
+      counters.eliminations = spa.eliminations;
+      counters.fillIn = spa.fillIn;
+      _checkpoint->save_snapshot(_id, n, counters, gaussFF);
+      lastSnapshot = std::chrono::steady_clock::now();
     }
-    if (equation.empty())
-      continue;
-    equation.normalize();
 
-    for (unsigned i = 1; i < equation.size();) {
-      if (_lineNumber.contains(equation[i]))
-        equation.eliminate(_gaussFF[_lineNumber[equation[i]]], i);
-      else
-        ++i;
+    EquationMod<T> equation =
+        merger ? merger->next() : std::move(systemFF[n]);
+    equation.reduce(_lineNumber, gaussFF, spa);
+    if (equation.empty()) {
+      ++counters.zero;
+      continue;
     }
 
-    _lineNumber[equation.first_integral()] = _gaussFF.size();
-    _gaussFF.emplace_back(std::move(equation));
+    _lineNumber[equation.first_integral()] = gaussFF.size();
+    gaussFF.emplace_back(std::move(equation));
   }
-
+  timer.reset();
+  if (_progress)
+    _progress->sector_end(_id);
+
+  Stats::count(Counter::Equations, nsystem);
+  Stats::count(Counter::SpilledEquations, system.nspilled);
+  Stats::count(Counter::ZeroEquations, system.nzero + counters.zero);
+  Stats::count(Counter::Eliminations, spa.eliminations);
+  Stats::count(Counter::FillIn, spa.fillIn);
+  Stats::count(Counter::Pivots, gaussFF.size());
+
+  TableWriter<T> table(_id, _seeds);
   for (unsigned i = 0; i < _seeds.size(); ++i) {
     if (_seeds[i].depth() < _depth && _seeds[i].rank() < _rank) {
-      if (!_lineNumber.contains(i))
-        std::cout << "      " << _seeds[i] << "  # " << _id << std::endl;
+      if (_lineNumber[i] == NO_PIVOT) {
+        LOG_INFO("      " << _seeds[i] << "  # " << _id);
+        table.add_master(i);
+      }
     }
   }
+  // pivot rows: integral = -sum coeff * integral
+  for (const auto &equation : gaussFF) {
+    std::vector<std::pair<unsigned, T>> terms;
+    for (unsigned i = 1; i < equation.size(); ++i)
+      terms.emplace_back(equation[i], -equation.coeff(i));
+    table.add_row(equation.first_integral(), std::move(terms));
+  }
+  if (!_tablePath.empty()) {
+    std::string path = table_file(_tablePath, _id);
+    table.write(path);
+    if (_checkpoint)
+      _checkpoint->complete(_id, path);
+  }
 
-  _systemFF.clear();
-  _gaussFF.clear();
+  _lineNumber.clear();
   _seeds.clear();
   _weights.clear();
 
   return 1;
 }
 
-unsigned Sector::sector_reduction_sym(const std::vector<IBPProto> &ibps) {
+template unsigned Sector::run_reduce(const std::vector<IBPProtoMod<umod64>> &);
+template unsigned Sector::run_reduce(const std::vector<IBPProtoMod<umod50>> &);
+template unsigned Sector::run_reduce(const std::vector<IBPProtoMod<umod31>> &);
+template SectorSystem<umod64>
+Sector::run_generate(const std::vector<IBPProtoMod<umod64>> &);
+template SectorSystem<umod50>
+Sector::run_generate(const std::vector<IBPProtoMod<umod50>> &);
+template SectorSystem<umod31>
+Sector::run_generate(const std::vector<IBPProtoMod<umod31>> &);
+template unsigned Sector::run_eliminate(SectorSystem<umod64> &&);
+template unsigned Sector::run_eliminate(SectorSystem<umod50> &&);
+template unsigned Sector::run_eliminate(SectorSystem<umod31> &&);
+
+unsigned Sector::sector_reduction_sym(const std::vector<IBPProtoSym> &ibps) {
+  // coefficients are rational functions in the symbols
+  std::vector<std::string> names;
+  for (const auto &symbol : _symbols)
+    names.push_back(symbol.get_name());
+  RatFunContext ctx(names);
+
+  // the coefficients of indices of each ibp term, converted once
+  // the coefficient of a seed is c_0 + seed[0] * c_1 + ... + seed[n-1] * c_n
+  std::vector<std::vector<std::pair<RawIntegral, std::vector<RationalFunction>>>>
+      ibpsSym;
+  for (const auto &ibp : ibps) {
+    std::vector<std::pair<RawIntegral, std::vector<RationalFunction>>> ibpSym;
+    for (const auto &item : ibp) {
+      std::vector<RationalFunction> coeffs;
+      for (const auto &coeff : item.second)
+        coeffs.push_back(RationalFunction::from_poly(ctx, coeff));
+      ibpSym.emplace_back(item.first, std::move(coeffs));
+    }
+    ibpsSym.emplace_back(std::move(ibpSym));
+  }
+
   // generate the system
   for (const auto &seed : _seeds) {
     if (seed.depth() < _depth && seed.rank() < _rank) {
-      for (const auto &ibp : ibps) {
+      for (const auto &ibp : ibpsSym) {
         EquationSym equation;
         // generate the ibp equation
         for (const auto &item : ibp) {
-          RawIntegral integral = seed + item.first;
-          if (!_weights.contains(integral))
+          auto weight = _weights.find(seed + item.first);
+          if (weight == _weights.end())
             continue;
-          // check if coefficient is zero
-          GiNaC::lst values;
+          const auto &coeffs = item.second;
+          RationalFunction coeff = coeffs[_nprops];
           for (unsigned p = 0; p < _nprops; ++p)
-            values.append(_symIndices[p] == seed[p]);
-          GiNaC::ex coeff = item.second.subs(values).expand();
-          std::cout << coeff << std::endl;
-          if (coeff == 0)
+            if (seed[p] != 0 && !coeffs[p].is_zero())
+              coeff += coeffs[p] * seed[p];
+          // check if coefficient is zero
+          if (coeff.is_zero())
             continue;
-          equation.insert(_weights[integral], coeff);
+          equation.insert(weight->second, std::move(coeff));
         }
         if (equation.empty())
           continue;
@@ -186,27 +398,25 @@ unsigned Sector::sector_reduction_sym(const std::vector<IBPProto> &ibps) {
     }
   }
   std::sort(_systemS1.begin(), _systemS1.end());
+  _lineNumber.assign(_seeds.size(), NO_PIVOT);
 
   std::string recordPath = "record_" + std::to_string(_id);
   std::ofstream record(recordPath);
 
   // gauss elimination
   for (auto &equation : _systemS1) {
-    std::cout << equation.eqnum << std::endl;
-    while (!equation.empty() && _lineNumber.contains(equation[0])) {
-      std::cout << _gaussS[_lineNumber[equation[0]]].eqnum << " ";
+    LOG_TRACE("sector " << _id << " equation " << equation.eqnum);
+    while (!equation.empty() && _lineNumber[equation[0]] != NO_PIVOT) {
+      LOG_TRACE("  eliminated by " << _gaussS[_lineNumber[equation[0]]].eqnum);
       equation.eliminate(_gaussS[_lineNumber[equation[0]]], 0);
     }
-    if (equation.empty()) {
-      std::cout << "\n" << std::endl;
-
+    if (equation.empty())
       continue;
-    }
     equation.normalize();
 
     for (unsigned i = 1; i < equation.size();) {
-      if (_lineNumber.contains(equation[i])) {
-        std::cout << _gaussS[_lineNumber[equation[i]]].eqnum << " ";
+      if (_lineNumber[equation[i]] != NO_PIVOT) {
+        LOG_TRACE("  eliminated by " << _gaussS[_lineNumber[equation[i]]].eqnum);
         equation.eliminate(_gaussS[_lineNumber[equation[i]]], i);
       } else
         ++i;
@@ -214,29 +424,27 @@ unsigned Sector::sector_reduction_sym(const std::vector<IBPProto> &ibps) {
 
     _lineNumber[equation.first_integral()] = _gaussS.size();
     _gaussS.emplace_back(std::move(equation));
-
-    std::cout << "\n" << std::endl;
   }
 
   for (unsigned i = 0; i < _seeds.size(); ++i) {
     if (_seeds[i].depth() < _depth && _seeds[i].rank() < _rank) {
-      if (!_lineNumber.contains(i))
-        std::cout << "      " << _seeds[i] << "  # " << _id << std::endl;
+      if (_lineNumber[i] == NO_PIVOT)
+        LOG_INFO("      " << _seeds[i] << "  # " << _id);
     }
   }
 
   std::string path = "result_" + std::to_string(_id);
   std::ofstream file(path);
 
-  for (const auto &item : _lineNumber) {
-    file << _seeds[item.first] << std::endl;
-    unsigned num = _gaussS[item.second].size();
+  for (const auto &equation : _gaussS) {
+    file << _seeds[equation.first_integral()] << std::endl;
+    unsigned num = equation.size();
     if (num > 1) {
       for (unsigned i = 1; i < num - 1; ++i)
-        file << "(" << -_gaussS[item.second].coeff(i) << ")*"
-             << _seeds[_gaussS[item.second][i]] << "+";
-      file << "(" << -_gaussS[item.second].coeff(num - 1) << ")*"
-           << _seeds[_gaussS[item.second][num - 1]];
+        file << "(" << -equation.coeff(i) << ")*" << _seeds[equation[i]]
+             << "+";
+      file << "(" << -equation.coeff(num - 1) << ")*"
+           << _seeds[equation[num - 1]];
       file << "\n" << std::endl;
     } else
       file << "0\n" << std::endl;
@@ -244,6 +452,7 @@ unsigned Sector::sector_reduction_sym(const std::vector<IBPProto> &ibps) {
 
   _systemS1.clear();
   _gaussS.clear();
+  _lineNumber.clear();
   _seeds.clear();
   _weights.clear();
 
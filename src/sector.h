@@ -1,12 +1,17 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <queue>
 #include <unordered_map>
 #include <vector>
 
+#include "arith/poly.h"
+#include "arith/rational.h"
 #include "arith/umod.h"
 #include "ginac/ginac.h"
 #include "yaml-cpp/yaml.h"
@@ -14,9 +19,12 @@
 #include "fflow/graph.hh"
 
 #include "equation.h"
+#include "spill.h"
 #include "utils.h"
 
 class Reduce;
+class Checkpoint;
+class Progress;
 
 class RawIntegral {
 public:
@@ -101,17 +109,67 @@ private:
   std::vector<int> indices;
 };
 
+// hash of the indices of an integral
+inline std::size_t hash_indices(const int *indices, std::size_t n) {
+  std::size_t hash = n;
+  for (std::size_t k = 0; k < n; ++k)
+    hash ^= indices[k] + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
 namespace std {
 template <> struct hash<RawIntegral> {
   std::size_t operator()(const RawIntegral &integral) const {
-    std::size_t hash = integral.size();
-    for (auto i : integral.indices)
-      hash ^= i + 0x9e3779b9 + (hash << 6) + (hash >> 2);
-    return hash;
+    return hash_indices(integral.indices.data(), integral.size());
   }
 };
 } // namespace std
 
+// indices of an integral with a fixed number N of propagators
+// the reduction is specialized on N for the common sizes, see
+// Sector::_generate_system
+template <unsigned N> using FixedIntegral = std::array<int, N>;
+
+// hash and equality of integrals, transparent so that a FixedIntegral is
+// looked up among RawIntegral keys without allocating
+struct IntegralHash {
+  using is_transparent = void;
+
+  std::size_t operator()(const RawIntegral &integral) const {
+    return std::hash<RawIntegral>()(integral);
+  }
+
+  template <std::size_t N>
+  std::size_t operator()(const std::array<int, N> &integral) const {
+    return hash_indices(integral.data(), N);
+  }
+};
+
+struct IntegralEqual {
+  using is_transparent = void;
+
+  bool operator()(const RawIntegral &lhs, const RawIntegral &rhs) const {
+    return lhs == rhs;
+  }
+
+  template <std::size_t N>
+  bool operator()(const std::array<int, N> &lhs,
+                  const RawIntegral &rhs) const {
+    if (rhs.size() != N)
+      return false;
+    for (unsigned k = 0; k < N; ++k)
+      if (lhs[k] != rhs[k])
+        return false;
+    return true;
+  }
+
+  template <std::size_t N>
+  bool operator()(const RawIntegral &lhs,
+                  const std::array<int, N> &rhs) const {
+    return (*this)(rhs, lhs);
+  }
+};
+
 namespace YAML {
 template <> struct convert<RawIntegral> {
   static bool decode(const Node &node, RawIntegral &integral) {
@@ -127,27 +185,61 @@ template <> struct convert<RawIntegral> {
 // first:  integral indices
 // second: coefficient
 typedef std::vector<std::pair<RawIntegral, GiNaC::ex>> IBPProto;
-// ibp relation over finite field
+// ibp relation with sparse polynomial coefficients
+// first:  integral indices
+// second: coefficient in a1, ..., an and the symbols
+typedef std::vector<std::pair<RawIntegral, SparsePoly<Rational>>> IBPProtoPoly;
+// ibp relation over a finite field
 // first:  integral indices
 // second: coefficients of indices
-typedef std::vector<std::pair<RawIntegral, std::vector<umod64>>> IBPProtoFF;
+template <typename T>
+using IBPProtoMod = std::vector<std::pair<RawIntegral, std::vector<T>>>;
+typedef IBPProtoMod<umod64> IBPProtoFF;
+// ibp relation for the symbolic reduction
+// first:  integral indices
+// second: coefficients of indices, polynomials in the symbols
+typedef std::vector<std::pair<RawIntegral, std::vector<SparsePoly<Rational>>>>
+    IBPProtoSym;
+
+// generated and ordered ibp system of a sector over the field of T
+// the output of Sector::run_generate and the input of Sector::run_eliminate
+template <typename T> struct SectorSystem {
+  // equations in elimination order, empty if the system is spilled
+  std::vector<EquationMod<T>> equations;
+  // sorted runs of a spilled system, nullptr if it is in memory
+  std::unique_ptr<SpillFile> spill;
+  // number of equations
+  unsigned size = 0;
+  // equations generated empty
+  uint64_t nzero = 0;
+  // equations spilled to disk
+  uint64_t nspilled = 0;
+};
+
+template <typename T> class LearnedSector;
 
 class Sector {
 public:
   friend class Reduce;
+  template <typename T> friend class LearnedSector;
 
   // generate seeds and read targets
   void prepare_targets(const std::vector<RawIntegral> &);
-  // run the reduction
-  unsigned run_reduce(const std::vector<IBPProtoFF> &);
+  // run the reduction over the field of T
+  // the same as run_eliminate(run_generate(ibps))
+  template <typename T>
+  unsigned run_reduce(const std::vector<IBPProtoMod<T>> &);
+  // generate the seeds and the ordered system over the field of T
+  template <typename T>
+  SectorSystem<T> run_generate(const std::vector<IBPProtoMod<T>> &);
+  // eliminate a system of run_generate and write the reduction table
+  template <typename T> unsigned run_eliminate(SectorSystem<T> &&);
   // run the symbolic reduction
-  unsigned run_reduce_sym(const std::vector<IBPProto> &);
+  unsigned run_reduce_sym(const std::vector<IBPProtoSym> &);
   // run the finiteflow reduction
   unsigned run_reduce_ff(const std::vector<IBPProto> &);
-  // run sector reduction
-  unsigned sector_reduction(const std::vector<IBPProtoFF> &);
   // run symbolic reduction
-  unsigned sector_reduction_sym(const std::vector<IBPProto> &);
+  unsigned sector_reduction_sym(const std::vector<IBPProtoSym> &);
   // run finiteflow reduction
   unsigned sector_reduction_ff(const std::vector<IBPProto> &);
 
@@ -156,12 +248,18 @@ public:
 private:
   // generate seeds satisfying the depth and rank
   void _generate_seeds();
+  // generate the ibp system over the field of T, emit(equation) is called
+  // for each non-empty sorted equation, returns the number of empty ones
+  // N: the number of propagators, 0 for the generic version
+  template <typename T, unsigned N, typename F>
+  uint64_t _generate_system(const std::vector<IBPProtoMod<T>> &, F emit);
 
 public:
   // dp of combinations
   // combinations[<number, sum>] -> [combinations]
   static std::map<std::pair<int, int>, std::vector<std::vector<int>>>
       combinations;
+  static std::mutex combinationsMutex;
   // fill the combinations up to <number, sum>
   static void generate_combinations(int number, int sum);
 
@@ -188,7 +286,8 @@ private:
   // seeds: weight to integral
   std::vector<RawIntegral> _seeds;
   // seeds: integral to weight
-  std::unordered_map<RawIntegral, unsigned> _weights;
+  std::unordered_map<RawIntegral, unsigned, IntegralHash, IntegralEqual>
+      _weights;
 
   // target integrals
   std::set<unsigned, std::greater<>> _targets;
@@ -201,13 +300,21 @@ private:
   // first: integral
   // second: number of ibp
   std::set<std::pair<unsigned, unsigned>> _usedIBP;
-  // the ibp system
-  std::vector<EquationFF> _systemFF;
-  std::vector<EquationFF> _gaussFF;
   // symbolic ibp system
   std::vector<EquationSym> _systemS1;
   std::vector<EquationSym> _systemS2;
   std::vector<EquationSym> _gaussS;
-  // line number of each pivot
-  std::unordered_map<unsigned, unsigned> _lineNumber;
+  // line number of the pivot row of each integral weight, NO_PIVOT if none
+  std::vector<unsigned> _lineNumber;
+
+  // checkpoints of the reduction, nullptr if disabled
+  const Checkpoint *_checkpoint = nullptr;
+  // progress of the reduction, nullptr if disabled
+  Progress *_progress = nullptr;
+  // memory budget of the system in bytes, 0 if unlimited
+  uint64_t _memoryBudget = 0;
+  // directory of the spill file
+  std::string _spillPath;
+  // directory of the reduction table, empty if it is not written
+  std::string _tablePath = ".";
 };
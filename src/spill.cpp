@@ -0,0 +1,51 @@
+#include "spill.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// size of the write buffer
+static const size_t SPILL_BUFFER = 1 << 20;
+
+SpillFile::SpillFile(const std::string &path) {
+  std::string name = path + "/inibp_spill_XXXXXX";
+  _fd = mkstemp(name.data());
+  if (_fd < 0)
+    throw std::runtime_error("cannot create spill file in " + path);
+  unlink(name.c_str());
+  _buffer.reserve(SPILL_BUFFER);
+}
+
+SpillFile::~SpillFile() {
+  if (_fd >= 0)
+    close(_fd);
+}
+
+void SpillFile::_append(const void *data, size_t bytes) {
+  const char *p = static_cast<const char *>(data);
+  _buffer.insert(_buffer.end(), p, p + bytes);
+  _size += bytes;
+  if (_buffer.size() >= SPILL_BUFFER)
+    _flush();
+}
+
+void SpillFile::_load(void *data, size_t bytes, uint64_t offset) {
+  if (offset + bytes > _bufferOffset)
+    _flush();
+  if (pread(_fd, data, bytes, (off_t)offset) != (ssize_t)bytes)
+    throw std::runtime_error("cannot read spill file");
+}
+
+void SpillFile::_flush() {
+  size_t written = 0;
+  while (written < _buffer.size()) {
+    ssize_t n = pwrite(_fd, _buffer.data() + written, _buffer.size() - written,
+                       (off_t)(_bufferOffset + written));
+    if (n <= 0)
+      throw std::runtime_error("cannot write spill file");
+    written += n;
+  }
+  _bufferOffset += _buffer.size();
+  _buffer.clear();
+}
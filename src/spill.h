@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "equation.h"
+
+// temporary file of equations written out of memory
+// an equation is stored as uint32 eqnum, uint32 size and size pairs of
+// uint32 integral and uint64 coefficient
+// the equations are grouped in runs, each run is sorted
+// the file is unlinked on creation and disappears when closed
+class SpillFile {
+public:
+  // create the file in the directory path
+  explicit SpillFile(const std::string &path);
+
+  SpillFile(const SpillFile &) = delete;
+
+  SpillFile &operator=(const SpillFile &) = delete;
+
+  ~SpillFile();
+
+  // append the sorted equations as a new run
+  template <typename T>
+  void write_run(const std::vector<EquationMod<T>> &equations) {
+    uint64_t begin = _size;
+    for (const auto &equation : equations) {
+      uint32_t header[2] = {equation.eqnum, equation.size()};
+      _append(header, sizeof(header));
+      for (unsigned i = 0; i < equation.size(); ++i) {
+        uint32_t integral = equation[i];
+        uint64 coeff = equation.coeff(i).value();
+        _append(&integral, sizeof(integral));
+        _append(&coeff, sizeof(coeff));
+      }
+    }
+    _runs.emplace_back(begin, _size);
+  }
+
+  // read the equation at offset and advance offset to the next one
+  template <typename T> EquationMod<T> read(uint64_t &offset) {
+    uint32_t header[2];
+    _load(header, sizeof(header), offset);
+    _readBuffer.resize((size_t)header[1] * 12);
+    _load(_readBuffer.data(), _readBuffer.size(), offset + sizeof(header));
+
+    EquationMod<T> equation;
+    equation.eqnum = header[0];
+    for (unsigned i = 0; i < header[1]; ++i) {
+      uint32_t integral;
+      uint64 coeff;
+      std::memcpy(&integral, _readBuffer.data() + 12 * i, 4);
+      std::memcpy(&coeff, _readBuffer.data() + 12 * i + 4, 8);
+      equation.insert(integral, T{coeff});
+    }
+    offset += sizeof(header) + _readBuffer.size();
+    return equation;
+  }
+
+  // [begin, end) offsets of the runs
+  [[nodiscard]] const std::vector<std::pair<uint64_t, uint64_t>> &
+  runs() const {
+    return _runs;
+  }
+
+  // bytes written
+  [[nodiscard]] uint64_t size() const { return _size; }
+
+private:
+  // append bytes through the write buffer
+  void _append(const void *data, size_t bytes);
+
+  // read bytes at offset
+  void _load(void *data, size_t bytes, uint64_t offset);
+
+  // write the buffer to the file
+  void _flush();
+
+private:
+  int _fd = -1;
+  uint64_t _size = 0;
+  // offset of the buffer in the file
+  uint64_t _bufferOffset = 0;
+  std::vector<char> _buffer;
+  std::vector<char> _readBuffer;
+  std::vector<std::pair<uint64_t, uint64_t>> _runs;
+};
+
+// k-way merge of the runs of a SpillFile in the order of EquationMod
+// only the head equation of each run is held in memory
+template <typename T> class RunMerger {
+public:
+  explicit RunMerger(SpillFile &file) : _file(file), _cursors(file.runs()) {
+    for (unsigned run = 0; run < _cursors.size(); ++run)
+      _advance(run);
+  }
+
+  [[nodiscard]] bool empty() const { return _heap.empty(); }
+
+  // the next equation in order
+  EquationMod<T> next() {
+    std::pop_heap(_heap.begin(), _heap.end(), _heap_less);
+    auto [equation, run] = std::move(_heap.back());
+    _heap.pop_back();
+    _advance(run);
+    return equation;
+  }
+
+private:
+  // order of the heap: the smallest equation on top
+  static bool _heap_less(const std::pair<EquationMod<T>, unsigned> &a,
+                         const std::pair<EquationMod<T>, unsigned> &b) {
+    return b.first < a.first;
+  }
+
+  // read the next equation of the run into the heap
+  void _advance(unsigned run) {
+    auto &[offset, end] = _cursors[run];
+    if (offset == end)
+      return;
+    _heap.emplace_back(_file.read<T>(offset), run);
+    std::push_heap(_heap.begin(), _heap.end(), _heap_less);
+  }
+
+private:
+  SpillFile &_file;
+  // current offset of each run
+  std::vector<std::pair<uint64_t, uint64_t>> _cursors;
+  // head equations and their runs, smallest on top
+  std::vector<std::pair<EquationMod<T>, unsigned>> _heap;
+};
@@ -0,0 +1,112 @@
+#include "stats.h"
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+std::mutex Stats::_mutex;
+std::chrono::steady_clock::time_point Stats::_start =
+    std::chrono::steady_clock::now();
+std::array<std::atomic<uint64_t>, (unsigned)Counter::Size> Stats::_counters{};
+std::map<std::string, Timing> Stats::_phases;
+std::map<unsigned, std::map<std::string, Timing>> Stats::_sectors;
+
+// names of the counters in the report
+static const char *COUNTER_NAMES[] = {"equations", "zero_equations",
+                                      "eliminations", "fill_in", "pivots",
+                                      "spilled_equations", "samples",
+                                      "unlucky_samples"};
+static_assert(std::size(COUNTER_NAMES) == (unsigned)Counter::Size);
+
+double thread_cpu_time() {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void Stats::record(const std::string &phase, double wall, double cpu,
+                   int sector) {
+  std::lock_guard lock(_mutex);
+  _phases[phase].add(wall, cpu);
+  if (sector >= 0)
+    _sectors[sector][phase].add(wall, cpu);
+}
+
+uint64_t Stats::peak_memory() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is in kilobytes on linux
+  return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+uint64_t Stats::current_memory() {
+  // the second field of statm is the resident size in pages
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+void Stats::report(std::ostream &os) {
+  std::lock_guard lock(_mutex);
+
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu = (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+               (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              _start)
+                    .count();
+
+  auto timing = [&os](const Timing &t) {
+    os << "{\"count\": " << t.count << ", \"wall\": " << t.wall
+       << ", \"cpu\": " << t.cpu << ", \"max_wall\": " << t.maxWall << "}";
+  };
+  auto phases = [&](const std::map<std::string, Timing> &map,
+                    const std::string &indent) {
+    os << "{";
+    for (auto it = map.begin(); it != map.end(); ++it) {
+      os << (it == map.begin() ? "\n" : ",\n") << indent << "  \""
+         << it->first << "\": ";
+      timing(it->second);
+    }
+    os << "\n" << indent << "}";
+  };
+
+  os << std::setprecision(6) << std::fixed;
+  os << "{\n  \"wall\": " << wall << ",\n  \"cpu\": " << cpu
+     << ",\n  \"peak_memory\": " << peak_memory() << ",\n  \"phases\": ";
+  phases(_phases, "  ");
+  os << ",\n  \"counters\": {";
+  for (unsigned i = 0; i < (unsigned)Counter::Size; ++i)
+    os << (i == 0 ? "\n" : ",\n") << "    \"" << COUNTER_NAMES[i]
+       << "\": " << _counters[i].load();
+  os << "\n  },\n  \"sectors\": {";
+  for (auto it = _sectors.begin(); it != _sectors.end(); ++it) {
+    os << (it == _sectors.begin() ? "\n" : ",\n") << "    \"" << it->first
+       << "\": ";
+    phases(it->second, "    ");
+  }
+  os << "\n  }\n}\n";
+}
+
+void Stats::write_report(const std::string &path) {
+  std::ofstream file(path);
+  if (!file)
+    throw std::runtime_error("cannot write report " + path);
+  report(file);
+}
+
+ScopedTimer::ScopedTimer(std::string phase, int sector)
+    : _phase(std::move(phase)), _sector(sector),
+      _wall(std::chrono::steady_clock::now()), _cpu(thread_cpu_time()) {}
+
+ScopedTimer::~ScopedTimer() {
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              _wall)
+                    .count();
+  Stats::record(_phase, wall, thread_cpu_time() - _cpu, _sector);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// counters of the reduction
+enum class Counter : unsigned {
+  // generated non-empty equations
+  Equations,
+  // equations generated empty or eliminated to zero
+  ZeroEquations,
+  // row reductions by a pivot row
+  Eliminations,
+  // terms created by eliminations
+  FillIn,
+  // pivot rows
+  Pivots,
+  // equations spilled to disk
+  SpilledEquations,
+  // sample points evaluated
+  Samples,
+  // sample points whose masters differ from the learned ones
+  UnluckySamples,
+  // number of counters
+  Size
+};
+
+// wall and cpu time of a phase
+struct Timing {
+  uint64_t count = 0;
+  double wall = 0;
+  double cpu = 0;
+  double maxWall = 0;
+
+  void add(double w, double c) {
+    ++count;
+    wall += w;
+    cpu += c;
+    maxWall = std::max(maxWall, w);
+  }
+};
+
+// process wide timers and counters, thread safe
+class Stats {
+public:
+  // add n to a counter
+  static void count(Counter counter, uint64_t n = 1) {
+    _counters[(unsigned)counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  // value of a counter
+  static uint64_t counter(Counter counter) {
+    return _counters[(unsigned)counter].load(std::memory_order_relaxed);
+  }
+
+  // record a phase, sector phases are also recorded per sector
+  static void record(const std::string &phase, double wall, double cpu,
+                     int sector = -1);
+
+  // peak resident memory in bytes
+  static uint64_t peak_memory();
+  // current resident memory in bytes
+  static uint64_t current_memory();
+
+  // write the report as JSON
+  static void report(std::ostream &);
+  // write the report to a file
+  static void write_report(const std::string &path);
+
+private:
+  static std::mutex _mutex;
+  static std::chrono::steady_clock::time_point _start;
+  static std::array<std::atomic<uint64_t>, (unsigned)Counter::Size> _counters;
+  static std::map<std::string, Timing> _phases;
+  static std::map<unsigned, std::map<std::string, Timing>> _sectors;
+};
+
+// measure wall and thread cpu time of the enclosing scope
+class ScopedTimer {
+public:
+  explicit ScopedTimer(std::string phase, int sector = -1);
+
+  ScopedTimer(const ScopedTimer &) = delete;
+
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  ~ScopedTimer();
+
+private:
+  std::string _phase;
+  int _sector;
+  std::chrono::steady_clock::time_point _wall;
+  double _cpu;
+};
+
+// cpu time of the calling thread in seconds
+double thread_cpu_time();
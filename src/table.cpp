@@ -0,0 +1,173 @@
+#include "table.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// check that a section of count items of bytes each lies inside the file
+static bool in_file(uint64_t offset, uint64_t count, uint64_t bytes,
+                    uint64_t size) {
+  return offset % 8 == 0 && offset <= size &&
+         (bytes == 0 || count <= (size - offset) / bytes);
+}
+
+// check that the sections of a mapped table are consistent, the tables of
+// remote workers are read through them
+static bool valid_table(const char *base, uint64_t size) {
+  const auto &header = *reinterpret_cast<const TableHeader *>(base);
+  if (!std::equal(TABLE_MAGIC, TABLE_MAGIC + 8, header.magic) ||
+      header.version != TABLE_VERSION || header.size != size ||
+      (header.field != TABLE_FF && header.field != TABLE_Q))
+    return false;
+  if (!in_file(header.keys, (uint64_t)header.nkeys * header.nprops,
+               sizeof(int32_t), size) ||
+      !in_file(header.rowKeys, header.nrows, sizeof(uint32_t), size) ||
+      !in_file(header.masters, header.nmasters, sizeof(uint32_t), size) ||
+      !in_file(header.rowPtr, (uint64_t)header.nrows + 1, sizeof(uint64_t),
+               size) ||
+      !in_file(header.cols, header.nterms, sizeof(uint32_t), size) ||
+      !in_file(header.coeffs, header.nterms, sizeof(uint64_t), size) ||
+      !in_file(header.blob, 0, 1, size))
+    return false;
+
+  const auto *rowKeys =
+      reinterpret_cast<const uint32_t *>(base + header.rowKeys);
+  const auto *masters =
+      reinterpret_cast<const uint32_t *>(base + header.masters);
+  const auto *rowPtr = reinterpret_cast<const uint64_t *>(base + header.rowPtr);
+  const auto *cols = reinterpret_cast<const uint32_t *>(base + header.cols);
+  const auto *coeffs =
+      reinterpret_cast<const uint64_t *>(base + header.coeffs);
+  // rows: ascending keys and a compressed sparse row layout of the terms
+  if (rowPtr[0] != 0 || rowPtr[header.nrows] != header.nterms)
+    return false;
+  for (uint32_t row = 0; row < header.nrows; ++row)
+    if (rowKeys[row] >= header.nkeys || rowPtr[row] > rowPtr[row + 1] ||
+        (row > 0 && rowKeys[row - 1] >= rowKeys[row]))
+      return false;
+  for (uint32_t i = 0; i < header.nmasters; ++i)
+    if (masters[i] >= header.nkeys)
+      return false;
+  for (uint64_t i = 0; i < header.nterms; ++i)
+    if (cols[i] >= header.nkeys)
+      return false;
+
+  // coefficients: residues or rationals inside the blob
+  uint64_t blobSize = size - header.blob;
+  for (uint64_t i = 0; i < header.nterms; ++i) {
+    if (header.field == TABLE_FF) {
+      if (coeffs[i] >= header.modulus)
+        return false;
+      continue;
+    }
+    uint64_t offset = coeffs[i];
+    if (offset % 8 != 0 || offset > blobSize || blobSize - offset < 8)
+      return false;
+    int32_t numSize;
+    uint32_t denSize;
+    std::memcpy(&numSize, base + header.blob + offset, 4);
+    std::memcpy(&denSize, base + header.blob + offset + 4, 4);
+    uint64_t nlimbs = (uint64_t)std::abs((int64_t)numSize) + denSize;
+    if (denSize == 0 || nlimbs > (blobSize - offset - 8) / sizeof(ulong))
+      return false;
+  }
+  return true;
+}
+
+ReductionTable::ReductionTable(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("cannot open reduction table " + path);
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TableHeader)) {
+    close(fd);
+    throw std::runtime_error("invalid reduction table " + path);
+  }
+  _size = st.st_size;
+  _data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (_data == MAP_FAILED) {
+    _data = nullptr;
+    throw std::runtime_error("cannot map reduction table " + path);
+  }
+
+  const char *base = static_cast<const char *>(_data);
+  _header = reinterpret_cast<const TableHeader *>(base);
+  if (!valid_table(base, _size)) {
+    munmap(_data, _size);
+    _data = nullptr;
+    throw std::runtime_error("invalid reduction table " + path);
+  }
+  _keys = reinterpret_cast<const int32_t *>(base + _header->keys);
+  _rowKeys = reinterpret_cast<const uint32_t *>(base + _header->rowKeys);
+  _masters = reinterpret_cast<const uint32_t *>(base + _header->masters);
+  _rowPtr = reinterpret_cast<const uint64_t *>(base + _header->rowPtr);
+  _cols = reinterpret_cast<const uint32_t *>(base + _header->cols);
+  _coeffs = reinterpret_cast<const uint64_t *>(base + _header->coeffs);
+  _blob = base + _header->blob;
+}
+
+ReductionTable::~ReductionTable() {
+  if (_data)
+    munmap(_data, _size);
+}
+
+std::optional<unsigned>
+ReductionTable::find_key(const RawIntegral &integral) const {
+  if (integral.size() != nprops())
+    return std::nullopt;
+  // binary search in the lexicographically sorted keys
+  unsigned lo = 0, hi = nkeys();
+  while (lo < hi) {
+    unsigned mid = (lo + hi) / 2;
+    auto indices = key(mid);
+    int cmp = 0;
+    for (unsigned i = 0; i < nprops() && cmp == 0; ++i)
+      if (indices[i] != integral[i])
+        cmp = indices[i] < integral[i] ? -1 : 1;
+    if (cmp == 0)
+      return mid;
+    else if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return std::nullopt;
+}
+
+std::optional<unsigned> ReductionTable::find(const RawIntegral &integral) const {
+  auto index = find_key(integral);
+  if (!index)
+    return std::nullopt;
+  const uint32_t *end = _rowKeys + nrows();
+  const uint32_t *it = std::lower_bound(_rowKeys, end, *index);
+  if (it == end || *it != *index)
+    return std::nullopt;
+  return it - _rowKeys;
+}
+
+Rational ReductionTable::coeff_q(uint64_t raw) const {
+  const char *data = _blob + raw;
+  int32_t numSize;
+  uint32_t denSize;
+  std::copy(data, data + 4, reinterpret_cast<char *>(&numSize));
+  std::copy(data + 4, data + 8, reinterpret_cast<char *>(&denSize));
+  const auto *limbs = reinterpret_cast<const ulong *>(data + 8);
+
+  fmpz_t numer, denom;
+  fmpz_init(numer);
+  fmpz_init(denom);
+  // a zero numerator has no limbs, the denominator has at least one
+  if (numSize != 0)
+    fmpz_set_ui_array(numer, limbs, std::abs(numSize));
+  fmpz_set_ui_array(denom, limbs + std::abs(numSize), denSize);
+  if (numSize < 0)
+    fmpz_neg(numer, numer);
+  Rational res(numer, denom);
+  fmpz_clear(numer);
+  fmpz_clear(denom);
+  return res;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "arith/rational.h"
+#include "arith/umod.h"
+
+#include "sector.h"
+#include "utils.h"
+
+// binary reduction table of one sector
+//
+// a table stores reduced rows  I_key = sum_j c_j * I_col_j
+// all sections are 8 bytes aligned and addressed by the header offsets:
+//  keys:    int32[nkeys * nprops], integrals sorted lexicographically
+//  rowKeys: uint32[nrows], key of each row, ascending
+//  masters: uint32[nmasters], keys of the master integrals
+//  rowPtr:  uint64[nrows + 1], first term of each row
+//  cols:    uint32[nterms], key of each term
+//  coeffs:  uint64[nterms], the residue mod modulus for TABLE_FF tables,
+//           the offset of the coefficient in blob for TABLE_Q tables
+//  blob:    rationals as int32 signed numerator limbs, uint32 denominator
+//           limbs, followed by the 64 bit limbs of both
+struct TableHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t field;
+  uint64_t modulus;
+  uint32_t sector;
+  uint32_t nprops;
+  uint32_t nkeys;
+  uint32_t nrows;
+  uint32_t nmasters;
+  uint32_t reserved;
+  uint64_t nterms;
+  // section offsets from the beginning of the file
+  uint64_t keys;
+  uint64_t rowKeys;
+  uint64_t masters;
+  uint64_t rowPtr;
+  uint64_t cols;
+  uint64_t coeffs;
+  uint64_t blob;
+  uint64_t size;
+};
+
+// path of the reduction table of a sector in a directory
+inline std::string table_file(const std::string &dir, unsigned sector) {
+  return dir + "/table_" + std::to_string(sector) + ".bin";
+}
+
+const char TABLE_MAGIC[8] = {'I', 'N', 'I', 'B', 'P', 'R', 'T', '\0'};
+const uint32_t TABLE_VERSION = 1;
+// coefficient fields
+const uint32_t TABLE_FF = 0;
+const uint32_t TABLE_Q = 1;
+
+// collect the rows of a sector and write them as a reduction table
+// T: umod64, umod50, umod31 or Rational
+template <typename T> class TableWriter {
+public:
+  // integrals: integral of each column number
+  TableWriter(unsigned sector, const std::vector<RawIntegral> &integrals)
+      : _sector(sector), _integrals(integrals) {}
+
+  // add the row integral = sum coeff * column
+  void add_row(unsigned integral,
+               std::vector<std::pair<unsigned, T>> &&terms) {
+    _rows.emplace_back(integral, std::move(terms));
+  }
+
+  // add a master integral
+  void add_master(unsigned integral) { _masters.push_back(integral); }
+
+  // write the table to path
+  void write(const std::string &path) const;
+
+private:
+  // encode a coefficient, rationals are appended to blob
+  template <typename Field>
+  static uint64_t _encode(const umod<Field> &coeff, std::vector<char> &) {
+    return coeff.value();
+  }
+
+  static uint64_t _encode(const Rational &coeff, std::vector<char> &blob) {
+    uint64_t offset = blob.size();
+    auto append = [&blob](const fmpz *num) {
+      std::vector<ulong> limbs(fmpz_size(num));
+      if (limbs.empty())
+        return;
+      fmpz_get_ui_array(limbs.data(), (slong)limbs.size(), num);
+      const char *data = reinterpret_cast<const char *>(limbs.data());
+      blob.insert(blob.end(), data, data + limbs.size() * sizeof(ulong));
+    };
+    auto numSize = (int32_t)fmpz_size(fmpq_numref(coeff.get()));
+    auto denSize = (uint32_t)fmpz_size(fmpq_denref(coeff.get()));
+    if (fmpz_sgn(fmpq_numref(coeff.get())) < 0)
+      numSize = -numSize;
+    blob.insert(blob.end(), reinterpret_cast<const char *>(&numSize),
+                reinterpret_cast<const char *>(&numSize) + 4);
+    blob.insert(blob.end(), reinterpret_cast<const char *>(&denSize),
+                reinterpret_cast<const char *>(&denSize) + 4);
+    append(fmpq_numref(coeff.get()));
+    append(fmpq_denref(coeff.get()));
+    return offset;
+  }
+
+private:
+  unsigned _sector;
+  const std::vector<RawIntegral> &_integrals;
+  std::vector<std::pair<unsigned, std::vector<std::pair<unsigned, T>>>> _rows;
+  std::vector<unsigned> _masters;
+};
+
+// read only view of a reduction table mapped into memory
+class ReductionTable {
+public:
+  // map the table at path, throws if it is not a valid table
+  explicit ReductionTable(const std::string &path);
+
+  ReductionTable(const ReductionTable &) = delete;
+
+  ReductionTable &operator=(const ReductionTable &) = delete;
+
+  ~ReductionTable();
+
+  [[nodiscard]] unsigned sector() const { return _header->sector; }
+
+  [[nodiscard]] unsigned nprops() const { return _header->nprops; }
+
+  [[nodiscard]] bool rational() const { return _header->field == TABLE_Q; }
+
+  // prime of a TABLE_FF table
+  [[nodiscard]] uint64_t modulus() const { return _header->modulus; }
+
+  // number of integral keys
+  [[nodiscard]] unsigned nkeys() const { return _header->nkeys; }
+
+  // number of reduced rows
+  [[nodiscard]] unsigned nrows() const { return _header->nrows; }
+
+  // indices of the key-th integral
+  [[nodiscard]] std::span<const int32_t> key(unsigned key) const {
+    return {_keys + (size_t)key * nprops(), nprops()};
+  }
+
+  // key of the integral
+  [[nodiscard]] std::optional<unsigned> find_key(const RawIntegral &) const;
+
+  // row of the integral, std::nullopt if it is not reduced
+  [[nodiscard]] std::optional<unsigned> find(const RawIntegral &) const;
+
+  // key of the reduced integral of the row
+  [[nodiscard]] unsigned row_key(unsigned row) const { return _rowKeys[row]; }
+
+  // keys of the terms of the row
+  [[nodiscard]] std::span<const uint32_t> row_cols(unsigned row) const {
+    return {_cols + _rowPtr[row], _cols + _rowPtr[row + 1]};
+  }
+
+  // raw coefficients of the terms of the row
+  [[nodiscard]] std::span<const uint64_t> row_coeffs(unsigned row) const {
+    return {_coeffs + _rowPtr[row], _coeffs + _rowPtr[row + 1]};
+  }
+
+  // keys of the master integrals
+  [[nodiscard]] std::span<const uint32_t> masters() const {
+    return {_masters, _header->nmasters};
+  }
+
+  // decode a raw coefficient of a TABLE_FF table over the field of T
+  template <typename T = umod64>
+  [[nodiscard]] static T coeff_ff(uint64_t raw) {
+    return T{raw};
+  }
+
+  // decode a raw coefficient of a TABLE_Q table
+  [[nodiscard]] Rational coeff_q(uint64_t raw) const;
+
+private:
+  void *_data = nullptr;
+  size_t _size = 0;
+
+  const TableHeader *_header = nullptr;
+  const int32_t *_keys = nullptr;
+  const uint32_t *_rowKeys = nullptr;
+  const uint32_t *_masters = nullptr;
+  const uint64_t *_rowPtr = nullptr;
+  const uint32_t *_cols = nullptr;
+  const uint64_t *_coeffs = nullptr;
+  const char *_blob = nullptr;
+};
+
+template <typename T>
+void TableWriter<T>::write(const std::string &path) const {
+  // keys: all referenced integrals in lexicographic order
+  std::vector<unsigned> columns;
+  for (const auto &row : _rows) {
+    columns.push_back(row.first);
+    for (const auto &term : row.second)
+      columns.push_back(term.first);
+  }
+  columns.insert(columns.end(), _masters.begin(), _masters.end());
+  std::sort(columns.begin(), columns.end(), [this](unsigned a, unsigned b) {
+    return _integrals[a] < _integrals[b];
+  });
+  columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+  std::unordered_map<unsigned, uint32_t> keyOf;
+  for (uint32_t i = 0; i < columns.size(); ++i)
+    keyOf[columns[i]] = i;
+
+  // rows in the order of their keys
+  std::vector<unsigned> order(_rows.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return keyOf[_rows[a].first] < keyOf[_rows[b].first];
+  });
+
+  std::vector<uint32_t> rowKeys, masters, cols;
+  std::vector<uint64_t> rowPtr{0}, coeffs;
+  std::vector<char> blob;
+  for (unsigned i : order) {
+    rowKeys.push_back(keyOf[_rows[i].first]);
+    for (const auto &term : _rows[i].second) {
+      cols.push_back(keyOf[term.first]);
+      coeffs.push_back(_encode(term.second, blob));
+    }
+    rowPtr.push_back(cols.size());
+  }
+  for (unsigned master : _masters)
+    masters.push_back(keyOf[master]);
+  std::sort(masters.begin(), masters.end());
+
+  // header and section offsets
+  auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+  unsigned nprops = _integrals.empty() ? 0 : _integrals[0].size();
+  TableHeader header{};
+  std::copy(TABLE_MAGIC, TABLE_MAGIC + 8, header.magic);
+  header.version = TABLE_VERSION;
+  if constexpr (std::is_same_v<T, Rational>)
+    header.field = TABLE_Q;
+  else {
+    header.field = TABLE_FF;
+    header.modulus = T::modulus();
+  }
+  header.sector = _sector;
+  header.nprops = nprops;
+  header.nkeys = columns.size();
+  header.nrows = rowKeys.size();
+  header.nmasters = masters.size();
+  header.nterms = cols.size();
+  header.keys = align(sizeof(TableHeader));
+  header.rowKeys = align(header.keys + sizeof(int32_t) * nprops * columns.size());
+  header.masters = align(header.rowKeys + sizeof(uint32_t) * rowKeys.size());
+  header.rowPtr = align(header.masters + sizeof(uint32_t) * masters.size());
+  header.cols = align(header.rowPtr + sizeof(uint64_t) * rowPtr.size());
+  header.coeffs = align(header.cols + sizeof(uint32_t) * cols.size());
+  header.blob = align(header.coeffs + sizeof(uint64_t) * coeffs.size());
+  header.size = header.blob + blob.size();
+
+  // written through a temporary file and renamed, a table linked into the
+  // checkpoints is replaced instead of overwritten
+  std::string tmp = path + ".tmp";
+  std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("cannot write reduction table " + tmp);
+  auto section = [&file](uint64_t offset, const void *data, size_t bytes) {
+    while ((uint64_t)file.tellp() < offset)
+      file.put(0);
+    file.write(static_cast<const char *>(data), (std::streamsize)bytes);
+  };
+  section(0, &header, sizeof(header));
+  std::vector<int32_t> keys;
+  keys.reserve((size_t)nprops * columns.size());
+  for (unsigned column : columns)
+    for (unsigned i = 0; i < nprops; ++i)
+      keys.push_back(_integrals[column][i]);
+  section(header.keys, keys.data(), sizeof(int32_t) * keys.size());
+  section(header.rowKeys, rowKeys.data(), sizeof(uint32_t) * rowKeys.size());
+  section(header.masters, masters.data(), sizeof(uint32_t) * masters.size());
+  section(header.rowPtr, rowPtr.data(), sizeof(uint64_t) * rowPtr.size());
+  section(header.cols, cols.data(), sizeof(uint32_t) * cols.size());
+  section(header.coeffs, coeffs.data(), sizeof(uint64_t) * coeffs.size());
+  section(header.blob, blob.data(), blob.size());
+  file.close();
+  if (!file)
+    throw std::runtime_error("cannot write reduction table " + tmp);
+  std::filesystem::rename(tmp, path);
+}
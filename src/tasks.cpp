@@ -0,0 +1,314 @@
+#include "tasks.h"
+#include "numa.h"
+
+#include <chrono>
+
+// scheduler and index of the worker thread
+static thread_local TaskScheduler *currentScheduler = nullptr;
+static thread_local int currentWorker = -1;
+
+// WorkDeque
+
+WorkDeque::WorkDeque() {
+  _arrays.emplace_back(std::make_unique<Array>(64));
+  _array.store(_arrays.back().get(), std::memory_order_relaxed);
+}
+
+WorkDeque::Array *WorkDeque::_grow(Array *array, int64_t top, int64_t bottom) {
+  _arrays.emplace_back(std::make_unique<Array>(array->capacity * 2));
+  Array *grown = _arrays.back().get();
+  for (int64_t i = top; i < bottom; ++i)
+    grown->put(i, array->get(i));
+  return grown;
+}
+
+void WorkDeque::push(Task *task) {
+  int64_t bottom = _bottom.load(std::memory_order_relaxed);
+  int64_t top = _top.load(std::memory_order_acquire);
+  Array *array = _array.load(std::memory_order_relaxed);
+  if (bottom - top > array->capacity - 1) {
+    array = _grow(array, top, bottom);
+    _array.store(array, std::memory_order_release);
+  }
+  array->put(bottom, task);
+  _bottom.store(bottom + 1, std::memory_order_release);
+}
+
+Task *WorkDeque::pop() {
+  int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+  Array *array = _array.load(std::memory_order_relaxed);
+  _bottom.store(bottom, std::memory_order_seq_cst);
+  int64_t top = _top.load(std::memory_order_seq_cst);
+
+  if (top > bottom) {
+    // empty
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Task *task = array->get(bottom);
+  if (top == bottom) {
+    // the last task, race against the thieves
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      task = nullptr;
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+Task *WorkDeque::steal() {
+  int64_t top = _top.load(std::memory_order_seq_cst);
+  int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+  if (top >= bottom)
+    return nullptr;
+
+  Array *array = _array.load(std::memory_order_acquire);
+  Task *task = array->get(top);
+  if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed))
+    return nullptr;
+  return task;
+}
+
+// TaskScheduler
+
+TaskScheduler::TaskScheduler(unsigned nthreads, bool numa) {
+  if (nthreads == 0)
+    nthreads = 1;
+  // every node used has a worker
+  unsigned nodes = std::min(NumaTopology::get().nodes(), nthreads);
+  _numa = numa && nodes > 1;
+  for (unsigned i = 0; i < nthreads; ++i) {
+    _workers.emplace_back(std::make_unique<Worker>());
+    // consecutive workers share a node
+    if (_numa)
+      _workers.back()->node = i * nodes / nthreads;
+  }
+  for (unsigned i = 0; i <= (_numa ? nodes : 1); ++i)
+    _queues.emplace_back(std::make_unique<Queue>());
+  for (unsigned i = 0; i < nthreads; ++i)
+    _threads.emplace_back(&TaskScheduler::_work, this, i);
+}
+
+TaskScheduler::~TaskScheduler() {
+  _stop.store(true);
+  _notify();
+  for (auto &thread : _threads)
+    thread.join();
+}
+
+TaskScheduler *TaskScheduler::current() { return currentScheduler; }
+
+void TaskScheduler::submit(std::function<void()> task, TaskGroup *group,
+                           TaskPriority priority, int affinity) {
+  if (group)
+    group->_pending.fetch_add(1, std::memory_order_relaxed);
+  Task *item = new Task{std::move(task), group};
+
+  // the deque of a worker of the node keeps the task on it
+  int node = affinity < 0 ? -1 : affinity % (int)nodes();
+  if (currentScheduler == this &&
+      (node < 0 || (unsigned)node == _workers[currentWorker]->node))
+    _workers[currentWorker]->deques[(unsigned)priority].push(item);
+  else {
+    Queue &queue = *_queues[node < 0 ? nodes() : node];
+    std::lock_guard lock(queue.mutex);
+    queue.tasks[(unsigned)priority].push_back(item);
+  }
+  _notify();
+}
+
+void TaskScheduler::_notify() {
+  _epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (_sleeping.load(std::memory_order_seq_cst) != 0) {
+    std::lock_guard lock(_sleepMutex);
+    _wake.notify_all();
+  }
+}
+
+Task *TaskScheduler::_pop(Queue &queue, TaskPriority priority) {
+  std::lock_guard lock(queue.mutex);
+  auto &tasks = queue.tasks[(unsigned)priority];
+  if (tasks.empty())
+    return nullptr;
+  Task *task = tasks.front();
+  tasks.pop_front();
+  return task;
+}
+
+Task *TaskScheduler::_steal(unsigned self, TaskPriority priority) {
+  unsigned n = _workers.size();
+  // start from the next worker so that the thieves spread out
+  for (unsigned k = 1; k < n; ++k) {
+    unsigned victim = (self + k) % n;
+    // the tasks of a node stay on it
+    if (_numa && _workers[victim]->node != _workers[self]->node)
+      continue;
+    if (Task *task = _workers[victim]->deques[(unsigned)priority].steal())
+      return task;
+  }
+  return nullptr;
+}
+
+Task *TaskScheduler::_find(unsigned self) {
+  Worker &worker = *_workers[self];
+  for (auto priority : {TaskPriority::High, TaskPriority::Normal}) {
+    if (Task *task = worker.deques[(unsigned)priority].pop())
+      return task;
+    if (Task *task = _pop(*_queues[worker.node], priority))
+      return task;
+    if (Task *task = _pop(*_queues[nodes()], priority))
+      return task;
+    if (Task *task = _steal(self, priority))
+      return task;
+  }
+  return nullptr;
+}
+
+void TaskScheduler::_execute(Task *task) {
+  TaskGroup *group = task->group;
+  std::exception_ptr error;
+  try {
+    task->run();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  delete task;
+  if (group)
+    group->_finish(error);
+}
+
+bool TaskScheduler::_help(TaskGroup *group) {
+  // the tasks pushed after the group's are finished before the waiting task
+  // returns to wait, so the group's tasks left in a deque are at its bottom
+  for (auto &deque : _workers[currentWorker]->deques) {
+    Task *task = deque.pop();
+    if (!task)
+      continue;
+    if (task->group != group) {
+      deque.push(task);
+      continue;
+    }
+    _execute(task);
+    return true;
+  }
+  return false;
+}
+
+void TaskScheduler::_work(unsigned self) {
+  currentScheduler = this;
+  currentWorker = (int)self;
+  if (_numa)
+    bind_to_node(_workers[self]->node);
+  while (true) {
+    uint64_t epoch = _epoch.load(std::memory_order_seq_cst);
+    if (Task *task = _find(self)) {
+      _execute(task);
+      continue;
+    }
+    if (_stop.load())
+      return;
+    // sleep until a task is submitted, the timeout covers a missed wake up
+    _sleeping.fetch_add(1, std::memory_order_seq_cst);
+    {
+      std::unique_lock lock(_sleepMutex);
+      _wake.wait_for(lock, std::chrono::milliseconds(10), [&] {
+        return _epoch.load(std::memory_order_seq_cst) != epoch ||
+               _stop.load();
+      });
+    }
+    _sleeping.fetch_sub(1, std::memory_order_seq_cst);
+  }
+}
+
+// TaskGroup
+
+void TaskGroup::_finish(const std::exception_ptr &error) {
+  // the waiter takes the mutex before returning, so the group outlives this
+  std::lock_guard lock(_mutex);
+  if (error && !_error)
+    _error = error;
+  if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    _done.notify_all();
+}
+
+void TaskGroup::_wait() {
+  auto finished = [this] {
+    return _pending.load(std::memory_order_acquire) == 0;
+  };
+  if (TaskScheduler::current() == &_scheduler) {
+    // a task is waiting, it runs the tasks of the group that were not stolen
+    // so that the workers are never all blocked on their own tasks; once
+    // they are all taken it spins a little for the short ones, then sleeps
+    // until the group finishes, looking for returned tasks now and then
+    unsigned spins = 0;
+    while (!finished()) {
+      if (_scheduler._help(this)) {
+        spins = 0;
+        continue;
+      }
+      if (++spins < 64) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock lock(_mutex);
+      _done.wait_for(lock, std::chrono::milliseconds(1), finished);
+    }
+    std::lock_guard lock(_mutex);
+  } else {
+    std::unique_lock lock(_mutex);
+    _done.wait(lock, finished);
+  }
+}
+
+void TaskGroup::wait() {
+  _wait();
+  std::exception_ptr error;
+  {
+    std::lock_guard lock(_mutex);
+    std::swap(error, _error);
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// TaskGraph
+
+unsigned TaskGraph::add(std::function<void()> task, TaskPriority priority,
+                        int affinity) {
+  Node &node = _nodes.emplace_back();
+  node.task = std::move(task);
+  node.priority = priority;
+  node.affinity = affinity;
+  return _nodes.size() - 1;
+}
+
+void TaskGraph::precede(unsigned before, unsigned after) {
+  _nodes[before].successors.push_back(after);
+  ++_nodes[after].npredecessors;
+}
+
+void TaskGraph::_submit(TaskGroup &group, unsigned node) {
+  Node &item = _nodes[node];
+  // the successors are submitted after the task, which may wait
+  group.submit(
+      [this, &group, node] {
+        Node &item = _nodes[node];
+        item.task();
+        for (unsigned next : item.successors)
+          if (_nodes[next].remaining.fetch_sub(1, std::memory_order_acq_rel) ==
+              1)
+            _submit(group, next);
+      },
+      item.priority, item.affinity);
+}
+
+void TaskGraph::run(TaskScheduler &scheduler) {
+  TaskGroup group(scheduler);
+  for (auto &node : _nodes)
+    node.remaining.store(node.npredecessors, std::memory_order_relaxed);
+  for (unsigned node = 0; node < _nodes.size(); ++node)
+    if (_nodes[node].npredecessors == 0)
+      _submit(group, node);
+  group.wait();
+}
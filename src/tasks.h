@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+class TaskScheduler;
+
+// priorities of the tasks, high priority tasks run first
+enum class TaskPriority : unsigned { High, Normal };
+
+// a submitted task
+struct Task {
+  std::function<void()> run;
+  TaskGroup *group = nullptr;
+};
+
+// Chase-Lev work stealing deque of tasks
+// the owner pushes and pops at the bottom, other threads steal from the top
+// without locks, the array grows when full and old arrays are kept until
+// the deque is destroyed since thieves may still read them
+class WorkDeque {
+public:
+  WorkDeque();
+
+  WorkDeque(const WorkDeque &) = delete;
+
+  WorkDeque &operator=(const WorkDeque &) = delete;
+
+  // owner only
+  void push(Task *task);
+  // owner only, nullptr if empty
+  Task *pop();
+  // any thread, nullptr if empty or lost a race
+  Task *steal();
+
+  [[nodiscard]] bool empty() const {
+    return _bottom.load(std::memory_order_relaxed) <=
+           _top.load(std::memory_order_relaxed);
+  }
+
+private:
+  // ring buffer of capacity 2^k
+  struct Array {
+    explicit Array(int64_t capacity)
+        : capacity(capacity), tasks(new std::atomic<Task *>[capacity]) {}
+
+    Task *get(int64_t i) const {
+      return tasks[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, Task *task) {
+      tasks[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+    }
+
+    int64_t capacity;
+    std::unique_ptr<std::atomic<Task *>[]> tasks;
+  };
+
+  // copy the tasks in [top, bottom) into an array of twice the capacity
+  Array *_grow(Array *array, int64_t top, int64_t bottom);
+
+private:
+  alignas(64) std::atomic<int64_t> _top{0};
+  alignas(64) std::atomic<int64_t> _bottom{0};
+  std::atomic<Array *> _array;
+  // all the arrays, the last one is current
+  std::vector<std::unique_ptr<Array>> _arrays;
+};
+
+// work stealing task scheduler
+// each worker owns a deque per priority, tasks submitted by a worker go to
+// its own deques, idle workers steal from the others
+// tasks submitted from other threads go to a shared queue
+// numa: the workers are spread over the NUMA nodes and bound to them, and
+// they only steal from the workers of their node, so the tasks spawned by a
+// task stay on its node and its memory, first touched there, stays local
+// a task with an affinity only runs on the workers of that node
+class TaskScheduler {
+public:
+  explicit TaskScheduler(unsigned nthreads, bool numa = false);
+
+  TaskScheduler(const TaskScheduler &) = delete;
+
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  // wait for the workers to finish all tasks and stop them
+  ~TaskScheduler();
+
+  // number of workers
+  [[nodiscard]] unsigned size() const { return _workers.size(); }
+
+  // number of NUMA nodes the workers are spread over, 1 if not numa
+  [[nodiscard]] unsigned nodes() const { return _queues.size() - 1; }
+
+  // run task on a worker, group is notified when it finishes
+  // affinity: NUMA node to run it on, -1 for any
+  void submit(std::function<void()> task, TaskGroup *group = nullptr,
+              TaskPriority priority = TaskPriority::Normal, int affinity = -1);
+
+  // scheduler running the calling thread, nullptr outside of the tasks
+  static TaskScheduler *current();
+
+  friend class TaskGroup;
+
+private:
+  struct Worker {
+    // NUMA node of the worker, 0 if not numa
+    unsigned node = 0;
+    WorkDeque deques[2];
+  };
+
+  // tasks submitted by other threads or for another node
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task *> tasks[2];
+  };
+
+  // find a task for the worker self
+  Task *_find(unsigned self);
+  // steal a task of priority from a worker other than self
+  Task *_steal(unsigned self, TaskPriority priority);
+  // pop a task of priority from a queue
+  static Task *_pop(Queue &queue, TaskPriority priority);
+  void _execute(Task *task);
+  // run a task of group from the deques of the calling worker, false if
+  // their next tasks belong to other groups
+  bool _help(TaskGroup *group);
+  // wake the sleeping workers
+  void _notify();
+  void _work(unsigned self);
+
+private:
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::thread> _threads;
+  // a queue per node for the tasks with an affinity, the last one for the
+  // others
+  std::vector<std::unique_ptr<Queue>> _queues;
+  // sleeping workers
+  std::mutex _sleepMutex;
+  std::condition_variable _wake;
+  std::atomic<uint64_t> _epoch{0};
+  std::atomic<unsigned> _sleeping{0};
+  std::atomic<bool> _stop{false};
+  bool _numa = false;
+};
+
+// a set of tasks that can be waited for
+// the first exception thrown by a task is rethrown by wait
+class TaskGroup {
+public:
+  explicit TaskGroup(TaskScheduler &scheduler) : _scheduler(scheduler) {}
+
+  TaskGroup(const TaskGroup &) = delete;
+
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  ~TaskGroup() { _wait(); }
+
+  // a task may only submit to the groups it waits for, or to other groups
+  // after its last wait; the destructor waits
+  void submit(std::function<void()> task,
+              TaskPriority priority = TaskPriority::Normal, int affinity = -1) {
+    _scheduler.submit(std::move(task), this, priority, affinity);
+  }
+
+  // wait for all the tasks
+  // a task of the same scheduler runs the tasks of the group left in its own
+  // deques meanwhile, never the tasks of other groups, so a waiting sector
+  // does not start another one; then it blocks like the other threads
+  void wait();
+
+  friend class TaskScheduler;
+
+private:
+  // a task of the group has finished
+  void _finish(const std::exception_ptr &error);
+  void _wait();
+
+private:
+  TaskScheduler &_scheduler;
+  std::atomic<unsigned> _pending{0};
+  std::mutex _mutex;
+  std::condition_variable _done;
+  std::exception_ptr _error;
+};
+
+// tasks with dependencies
+// the nodes are added first, then run once on a scheduler
+class TaskGraph {
+public:
+  // add a task, returns its node
+  // affinity: NUMA node to run it on, -1 for any
+  unsigned add(std::function<void()> task,
+               TaskPriority priority = TaskPriority::Normal,
+               int affinity = -1);
+
+  // node after starts when node before has finished
+  void precede(unsigned before, unsigned after);
+
+  // run all the nodes and wait for them, the successors of a failed node
+  // are not run
+  void run(TaskScheduler &scheduler);
+
+private:
+  struct Node {
+    std::function<void()> task;
+    TaskPriority priority;
+    int affinity;
+    std::vector<unsigned> successors;
+    unsigned npredecessors = 0;
+    std::atomic<unsigned> remaining{0};
+  };
+
+  void _submit(TaskGroup &group, unsigned node);
+
+private:
+  std::deque<Node> _nodes;
+};
+
+// f(i) for i in [begin, end) in chunks of grain indices
+// the chunks run on the scheduler of the calling task, or serially outside
+// of the tasks; they run before the tasks of normal priority, so a started
+// sector is finished before the next one starts
+template <typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F f) {
+  TaskScheduler *scheduler = TaskScheduler::current();
+  if (grain == 0)
+    grain = 1;
+  if (!scheduler || scheduler->size() == 1 || end - begin <= grain) {
+    for (size_t i = begin; i < end; ++i)
+      f(i);
+    return;
+  }
+  TaskGroup group(*scheduler);
+  for (size_t lo = begin; lo < end; lo += grain) {
+    size_t hi = std::min(end, lo + grain);
+    group.submit(
+        [lo, hi, &f] {
+          for (size_t i = lo; i < hi; ++i)
+            f(i);
+        },
+        TaskPriority::High);
+  }
+  group.wait();
+}
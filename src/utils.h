@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <mutex>
 #include <new>
+#include <string>
 #include <unordered_map>
 
+#include "log.h"
+
 template <typename T1, typename T2>
 std::ostream &operator<<(std::ostream &os, const std::pair<T1, T2> &p);
 
@@ -28,7 +32,28 @@ inline std::ostream &operator<<(std::ostream &os, const std::pair<T1, T2> &p) {
 }
 
 inline void process_finish(const std::string &result) {
-  std::cout << "\n\033[1m\033[36m Finish: \033[0m" << result << "\n"
-            << std::endl;
+  LOG_INFO("\n\033[1m\033[36m Finish: \033[0m" << result << "\n");
   exit(EXIT_SUCCESS);
 }
+
+// write a trivially copyable value to a binary stream
+template <typename T> inline void write_binary(std::ostream &os, const T &value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// read a trivially copyable value from a binary stream
+template <typename T> inline T read_binary(std::istream &is) {
+  T value{};
+  is.read(reinterpret_cast<char *>(&value), sizeof(T));
+  return value;
+}
+
+// 64 bit FNV-1a hash of a string
+inline uint64_t fnv1a(const std::string &s) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}